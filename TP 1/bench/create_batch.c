@@ -0,0 +1,73 @@
+/* Creation cost of dccthread_create_batch against a dccthread_create
+ * loop.
+ *
+ * usage: create_batch NTHREADS NROUNDS
+ *
+ * Each round creates NTHREADS threads that return right away, first
+ * one at a time and then with a single dccthread_create_batch call,
+ * and prints the time per thread spent creating them; the threads are
+ * waited for outside the timed region.  Later rounds of the loop reuse
+ * stacks freed by the threads of earlier rounds.  Set
+ * DCCTHREAD_STACK_COPY=1 to compare without dedicated stacks, where
+ * the first touch of each new stack no longer dominates.  Build from
+ * the directory with dccthread.c:
+ *
+ *   gcc -O2 -I. bench/create_batch.c dccthread.c dlist.c -o create_batch -lrt */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "dccthread.h"
+
+int nthreads, nrounds;
+dccthread_t **threads;
+struct dccthread_spec *specs;
+
+long long now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void tnop(int _) {
+}
+
+void test(int _) {
+	long long start, end;
+	int r, i;
+
+	for(i = 0; i < nthreads; i++) {
+		specs[i].name = "nop";
+		specs[i].func = tnop;
+		specs[i].param = i;
+	}
+
+	for(r = 0; r < nrounds; r++) {
+		start = now_ns();
+		for(i = 0; i < nthreads; i++)
+			threads[i] = dccthread_create("nop", tnop, i);
+		end = now_ns();
+		dccthread_wait_all(threads, nthreads);
+		printf("round %d loop:  %.0f ns per thread\n", r, (double)(end - start) / nthreads);
+
+		start = now_ns();
+		dccthread_create_batch(specs, nthreads, threads);
+		end = now_ns();
+		dccthread_wait_all(threads, nthreads);
+		printf("round %d batch: %.0f ns per thread\n", r, (double)(end - start) / nthreads);
+	}
+	dccthread_exit();
+}
+
+int main(int argc, char **argv)
+{
+	if(argc != 3) {
+		fprintf(stderr, "usage: %s NTHREADS NROUNDS\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+	nthreads = atoi(argv[1]);
+	nrounds = atoi(argv[2]);
+	threads = malloc(nthreads * sizeof(threads[0]));
+	specs = malloc(nthreads * sizeof(specs[0]));
+	dccthread_init(test, 0);
+}
@@ -0,0 +1,88 @@
+/* Cost of the dlist operations the scheduler uses most.
+ *
+ * usage: deque LENGTH NOPS
+ *
+ * Fills a list with LENGTH elements and times four workloads, each
+ * repeated NOPS times: moving the head to the tail (pop_left +
+ * push_right, as the ready list does on every yield), reading every
+ * element with dlist_get_index (as the simulation build scans the
+ * waiting list), and removing the first or the middle element with
+ * dlist_find_remove and putting it back at the tail.  Uses only the
+ * dlist_* interface, so the same driver builds against the ring-buffer
+ * deque and against the node list it replaced.  From the directory
+ * with dlist.c:
+ *
+ *   gcc -O2 -I. bench/deque.c dlist.c -o deque
+ *   mkdir -p old
+ *   git show 0060ab6^:"TP 1/dlist.h" > old/dlist.h
+ *   git show 0060ab6^:"TP 1/dlist.c" > old/dlist.c
+ *   gcc -O2 -Iold bench/deque.c old/dlist.c -o deque_old */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "dlist.h"
+
+long long now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int compare(const void *e1, const void *e2, void *userdata) {
+	return e1 != e2;
+}
+
+int main(int argc, char **argv)
+{
+	if(argc != 3) {
+		fprintf(stderr, "usage: %s LENGTH NOPS\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+	int length = atoi(argv[1]);
+	int nops = atoi(argv[2]);
+	long *items = malloc(length * sizeof(items[0]));
+	struct dlist *dl = dlist_create();
+	long long start, end;
+	long sum = 0;
+	int i, j;
+
+	for(i = 0; i < length; i++)
+		dlist_push_right(dl, &items[i]);
+
+	start = now_ns();
+	for(i = 0; i < nops; i++)
+		dlist_push_right(dl, dlist_pop_left(dl));
+	end = now_ns();
+	printf("pop_left + push_right: %8.1f ns\n", (double)(end - start) / nops);
+
+	start = now_ns();
+	for(i = 0; i < nops; i++)
+		for(j = 0; j < length; j++)
+			sum += (long)dlist_get_index(dl, j);
+	end = now_ns();
+	printf("get_index scan:        %8.1f us\n", (double)(end - start) / nops / 1000);
+
+	start = now_ns();
+	for(i = 0; i < nops; i++) {
+		void *head = dlist_get_index(dl, 0);
+		dlist_push_right(dl, dlist_find_remove(dl, head, compare, NULL));
+	}
+	end = now_ns();
+	printf("find_remove(head):     %8.1f ns\n", (double)(end - start) / nops);
+
+	start = now_ns();
+	for(i = 0; i < nops; i++) {
+		void *middle = dlist_get_index(dl, length / 2);
+		dlist_push_right(dl, dlist_find_remove(dl, middle, compare, NULL));
+	}
+	end = now_ns();
+	printf("find_remove(middle):   %8.1f ns\n", (double)(end - start) / nops);
+
+	// keeps the scan from being optimized away
+	if(sum == 0)
+		printf("empty scan\n");
+	dlist_destroy(dl, NULL);
+	free(items);
+	return 0;
+}
@@ -0,0 +1,69 @@
+/* Memory use and switch cost of the two stack modes.
+ *
+ * usage: stack_copy NTHREADS NYIELDS
+ *
+ * Creates NTHREADS threads that yield once and park, and prints the
+ * peak resident set size once all of them hold a stack.  Then two
+ * threads ping-pong through dccthread_yield NYIELDS times and the
+ * average cost of one switch is printed.  Set DCCTHREAD_STACK_COPY=1
+ * to run every thread on the shared stack.  Build from the directory
+ * with dccthread.c:
+ *
+ *   gcc -O2 -I. bench/stack_copy.c dccthread.c dlist.c -o stack_copy -lrt */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "dccthread.h"
+
+int nthreads, nyields;
+
+long long now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void tyield(int cnt) {
+	int i;
+	for(i = 0; i < cnt; i++)
+		dccthread_yield();
+}
+
+void test(int _) {
+	struct rusage ru;
+	long long start, end;
+	dccthread_t *peer;
+	int i;
+
+	for(i = 0; i < nthreads; i++)
+		dccthread_create("parked", tyield, 2);
+	// every thread runs once and parks in its first yield
+	dccthread_yield();
+	getrusage(RUSAGE_SELF, &ru);
+	printf("%d threads: maxrss %ld KiB\n", nthreads, ru.ru_maxrss);
+	// let the parked threads finish before timing the ping-pong
+	for(i = 0; i < 3; i++)
+		dccthread_yield();
+
+	peer = dccthread_create("peer", tyield, nyields);
+	start = now_ns();
+	for(i = 0; i < nyields; i++)
+		dccthread_yield();
+	end = now_ns();
+	dccthread_wait(peer);
+	printf("switch: %.0f ns\n", (double)(end - start) / (2.0 * nyields));
+	dccthread_exit();
+}
+
+int main(int argc, char **argv)
+{
+	if(argc != 3) {
+		fprintf(stderr, "usage: %s NTHREADS NYIELDS\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+	nthreads = atoi(argv[1]);
+	nyields = atoi(argv[2]);
+	dccthread_init(test, 0);
+}
@@ -1,7 +1,14 @@
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <string.h>
+#include <sched.h>
 #include <ucontext.h>
 #include <signal.h>
+#include <execinfo.h>
+#include <sys/time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 #include "dccthread.h"
 #include "dlist.h"
 #include <stdio.h>
@@ -9,16 +16,137 @@
 #define NSEC_VALUE 10000000
 #define SEC_VALUE 0
 
+// limites do modo adaptativo: a fatia mínima e quantas threads recém-criadas
+// na fila de prontas reduzem a fatia pela metade
+#define ADAPTIVE_MIN_NSEC 500000
+#define ADAPTIVE_FRESH_STEP 8
+
+// margem copiada abaixo do ponto de troca no modo de cópia de pilha, para
+// cobrir o endereço de retorno e registradores empilhados por swapcontext
+#define STACK_COPY_SLACK 256
+
+// distância entre as pilhas do bloco de dccthread_create_batch: uma linha de
+// cache além do tamanho da pilha, para que os topos das pilhas não caiam todos no
+// mesmo conjunto da cache
+#define BATCH_STACK_STRIDE (THREAD_STACK_SIZE + 64)
+
+// no modo de simulação (compilado com -DDCCTHREAD_SIM) cada escalonamento
+// avança o relógio virtual nesta quantidade de nanossegundos
+#define SIM_TICK_NSEC 1000
+
+// capacidade do buffer de amostras do profiler e profundidade máxima de pilha
+#define PROF_MAX_SAMPLES 16384
+#define PROF_MAX_DEPTH 32
+// quadros do próprio tratador de SIGPROF no topo de cada amostra
+#define PROF_SKIP_FRAMES 2
+
 // struct para representar uma thread
 typedef struct dccthread
 {
     char name[DCCTHREAD_MAX_NAME_SIZE]; // nome da thread
     ucontext_t context;                 // contexto da thread
-    char stack[THREAD_STACK_SIZE];      // tamanho da pilha da thread e posição inicial na memória
-    dccthread_t *waiting_for;           // thread pela qual esta thread está esperando
+    char *stack;                        // pilha dedicada da thread (NULL no modo de cópia de pilha)
+    void (*func)(int);                  // função executada pela thread
+    int param;                          // parâmetro passado para func
+    struct dlist *joiners;              // threads bloqueadas esperando o término desta thread
+    int join_remaining;                 // quantas threads esperadas ainda precisam terminar para acordar
     int has_waited;                     // flag que indica se a thread já passou por dccthread_wait()
+    int dispatched;                     // flag que indica se a thread já foi escalonada alguma vez
+    int exited;                         // flag que indica se a thread já terminou
+    char *stack_mark;                   // posição da pilha no momento em que a thread saiu da CPU
+    char *saved_stack;                  // cópia da parte viva da pilha compartilhada (modo de cópia)
+    size_t saved_size;                  // quantidade de bytes em saved_stack
+    size_t saved_capacity;              // tamanho alocado para saved_stack
+    long long wake_at;                  // instante (ns) em que uma thread dormindo deve acordar
+    struct dcc_gen *gen;                // gerador executando em nome da thread (NULL = pilha da thread)
+    char *gen_mark;                     // posição da pilha da thread ao entrar em um gerador
+    struct dlist *blocked_on;           // lista em que a thread está bloqueada (NULL se não está)
+    struct dcc_pool *pool;              // executor do qual a thread é trabalhadora
+    int cancel_pending;                 // flag que indica que a thread foi cancelada
+    struct dccthread_cleanup *cleanup;  // pilha de tratadores de limpeza (topo = último empilhado)
+    timer_t sleep_timer;                // temporizador da thread enquanto ela dorme
+    int sleeping;                       // flag que indica que sleep_timer existe e a thread está em waiting
+    struct dccthread *wake_next;        // próxima thread na pilha de despertares
+    int wake_queued;                    // flag que indica que a thread está na pilha de despertares
+    long long edf_period;               // período da classe EDF em ns (0 = thread comum)
+    long long edf_runtime;              // orçamento de CPU por período em ns
+    long long edf_deadline;             // prazo relativo ao início de cada período em ns
+    long long edf_release;              // início do job corrente (ou do próximo, se segurada)
+    long long edf_abs_deadline;         // prazo absoluto do job corrente
+    long long edf_budget;               // orçamento que resta ao job corrente
+    int edf_done;                       // flag que indica que a thread encerrou o job com yield
+    int edf_preempted;                  // flag que indica que a thread foi preemptada
+    int edf_throttled;                  // flag que indica que a thread espera o próximo período
+    struct dccthread_deadline_stats edf_stats; // estatísticas de prazos da thread
+    struct dccthread_slab *slab;        // bloco de pilhas de dccthread_create_batch (NULL = pilha própria)
+    unsigned long long cpu_ticks;       // tempo de CPU acumulado, em ciclos do TSC
+    unsigned long long cpu_limit;       // limite de tempo de CPU em ciclos (0 = sem limite)
+    int cpu_limit_action;               // o que fazer ao passar do limite (rebaixar ou cancelar)
+    int demoted;                        // flag que indica que a thread só executa quando não há outras
 } dccthread_t;
 
+// struct para o bloco de pilhas de um lote de threads criado de uma vez; o bloco
+// é liberado quando a última thread do lote termina
+typedef struct dccthread_slab
+{
+    char *stacks;                       // pilhas das threads do lote, uma após a outra
+    int live;                           // threads do lote que ainda não terminaram
+} dccthread_slab;
+
+// struct para um tratador de limpeza executado quando a thread é cancelada
+typedef struct dccthread_cleanup
+{
+    void (*routine)(void *);            // função de limpeza
+    void *arg;                          // argumento passado para routine
+    struct dccthread_cleanup *next;     // tratador empilhado antes deste
+} dccthread_cleanup;
+
+// struct para um gerador: uma corrotina com pilha própria que troca valores
+// diretamente com quem chama dcc_gen_next, sem passar pelo gerente
+typedef struct dcc_gen
+{
+    ucontext_t context;                 // contexto do gerador
+    ucontext_t caller;                  // contexto de quem chamou dcc_gen_next
+    char *stack;                        // pilha do gerador
+    void (*func)(int);                  // função executada pelo gerador
+    int param;                          // parâmetro passado para func
+    void *value;                        // último valor produzido por dcc_gen_yield
+    int started;                        // flag que indica se o gerador já começou a executar
+    int done;                           // flag que indica se func já retornou
+    dcc_gen_t *parent;                  // gerador que estava executando quando este foi retomado
+} dcc_gen_t;
+
+// struct para uma tarefa submetida a um executor
+typedef struct
+{
+    void (*func)(int);                  // função da tarefa
+    int param;                          // parâmetro passado para func
+    long long enqueued_at;              // instante (ns) em que a tarefa entrou na fila
+} dcc_job;
+
+// struct para um executor: trabalhadoras fixas e uma fila circular limitada de tarefas
+typedef struct dcc_pool
+{
+    dcc_job *jobs;                      // fila circular de tarefas
+    int capacity;                       // tamanho máximo da fila
+    int head;                           // posição da próxima tarefa a ser executada
+    int count;                          // quantidade de tarefas na fila
+    int nworkers;                       // quantidade de trabalhadoras
+    dccthread_t **workers;              // threads trabalhadoras
+    struct dlist *idle;                 // trabalhadoras bloqueadas esperando tarefas
+    struct dlist *submitters;           // threads bloqueadas esperando espaço na fila
+    int stopping;                       // flag que indica que o executor está sendo destruído
+    struct dcc_pool_stats stats;        // métricas de fila e de tempo de serviço
+} dcc_pool_t;
+
+// struct para uma amostra do profiler: a thread em execução e sua pilha de chamadas
+typedef struct
+{
+    dccthread_t *thread;                // thread que estava executando quando o sinal chegou
+    int depth;                          // quantidade de endereços em pcs
+    void *pcs[PROF_MAX_DEPTH];          // endereços de retorno, do mais interno para o mais externo
+} dccthread_sample;
+
 // struct auxiliar para definir um timer no momento de colocar threads em modo sleep
 typedef struct
 {
@@ -39,6 +167,45 @@ struct sigevent signalevent;
 struct itimerspec timerspec;
 struct sigaction action;
 
+// configuração da preempção (pode ser alterada antes ou depois de dccthread_init)
+struct timespec timeslice = {SEC_VALUE, NSEC_VALUE}; // fatia de tempo base
+clockid_t preemption_clock = CLOCK_PROCESS_CPUTIME_ID; // relógio que dispara a preempção
+int adaptive = 0;                       // modo adaptativo ligado/desligado
+int timer_created = 0;                  // flag que indica se o temporizador já existe
+long armed_nsec = -1;                   // fatia atualmente programada no temporizador (0 = desarmado)
+int nfresh = 0;                         // threads criadas que ainda não foram escalonadas
+
+// variáveis de suporte à classe EDF
+int nedf = 0;                           // quantidade de threads na classe EDF
+double edf_density = 0;                 // soma das densidades das threads EDF admitidas
+long long dispatched_at;                // leitura de preemption_clock quando a thread corrente recebeu a CPU
+
+dccthread_t *donated;                   // thread que recebe o restante da fatia em dccthread_yield_to
+
+// variáveis de suporte à contabilidade de tempo de CPU
+struct dlist *background;               // threads rebaixadas prontas, executadas só sem outras prontas
+unsigned long long ticks_origin;        // leitura do TSC em dccthread_init
+long long ticks_origin_ns;              // relógio monotônico real em dccthread_init
+double ticks_per_ns;                    // ciclos do TSC por nanossegundo, 0 até ser medido
+
+// variáveis de suporte ao modo de cópia de pilha
+int stack_copy = 0;                     // modo de cópia de pilha ligado/desligado
+char *shared_stack;                     // pilha onde todas as threads executam no modo de cópia
+dccthread_t *stack_owner;               // thread cujos dados estão na pilha compartilhada
+
+// variáveis de suporte ao profiler por amostragem
+dccthread_sample *prof_samples;         // buffer pré-alocado de amostras
+int prof_next = 0;                      // próxima posição livre (incrementada atomicamente)
+int prof_dropped = 0;                   // amostras descartadas por falta de espaço
+volatile sig_atomic_t in_manager = 0;   // flag que indica se o gerente está executando
+
+#ifdef DCCTHREAD_SIM
+// variáveis de suporte ao modo de simulação com relógio virtual
+long long sim_now = 0;                  // relógio virtual em nanossegundos
+unsigned long long sim_state = 0;       // estado do gerador pseudoaleatório (0 = escalonamento FIFO)
+int sim_seeded = 0;                     // flag que indica se a semente foi definida por dccthread_sim_seed
+#endif
+
 // variáveis de suporte à colocar threads em modo sleep
 dccthread_timer timer_sleep;
 struct sigevent signalevent_sleep;
@@ -48,70 +215,135 @@ struct sigaction action_sleep;
 // máscara de sinais bloqueados
 sigset_t mask;
 sigset_t mask_sleep;
+sigset_t mask_idle;
+
+// pilha lock-free das threads cujo temporizador de sono disparou; o tratador de
+// SIGRTMAX só empilha (sem malloc nem listas) e o gerente esvazia a pilha
+dccthread_t *wakeups = NULL;
 
 // funcionalidade extra: verificar quantas threads estão esperando por outras threads
 int dccthread_nwaiting()
 {
-    int size = 0;
-    struct dnode *current_thread = waiting->head;
-    // percorre a lista de threads esperando, incremento o tamanho a cada iteração
-    while (current_thread != NULL)
-    {
-        current_thread = current_thread->next;
-        size++;
-    }
-    return size;
+    return waiting->count;
 }
 
 // funcionalidade extra: verificar quantas threads finalizaram sem passar por dccthread_wait
 int dccthread_nexited(void)
 {
     int count = 0;
-    struct dnode *current_thread = finished->head;
     // percorre a lista de threads já finalizadas
-    while (current_thread != NULL)
+    for (int i = 0; i < finished->count; i++)
     {
-        dccthread_t *data = (dccthread_t *)current_thread->data;
+        dccthread_t *data = (dccthread_t *)dlist_get_index(finished, i);
         // se a thread indicar que não passou por dccthread_wait, incrementa o contador
         if (data->has_waited == 0)
         {
             count++;
         }
-        current_thread = current_thread->next;
     }
     return count;
 }
 
-// função auxiliar para verificar se uma thread está presente em uma lista (ambos passados como parâmetro)
-int is_thread_in_list(struct dlist *thread_list, dccthread_t *thread)
+// implementação da definição de cmp declarada e especificada em dlist.h
+int dccthread_compare(const void *e1, const void *e2, void *userdata)
 {
-    if (thread_list->count == 0)
-        return 0;
-
-    struct dnode *current_thread_item = thread_list->head;
-    while (current_thread_item != NULL && (dccthread_t *)current_thread_item->data != thread)
-    {
-        current_thread_item = current_thread_item->next;
-    }
-
-    if (current_thread_item != NULL)
-    {
-        return 1;
-    }
-
-    return 0;
+    return e1 != e2;
 }
 
 // função auxiliar para ser passada como parâmetro para o handler do sigaction 
 // (o atributo deve receber uma função com int como parâmetro)
+void dccthread_switch(dccthread_t *current_thread);
+
 void dccthread_preemption(int _)
 {
-    dccthread_yield();
+    // igual a dccthread_yield, mas sem pontos de cancelamento: uma thread cancelada
+    // nunca termina no meio do tratador de sinal, só quando chega a um ponto
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+
+    // uma thread EDF volta para a fila de prontas pelo gerente, que confere o orçamento
+    dccthread_t *current_thread = dccthread_self();
+    if (current_thread->edf_period)
+        current_thread->edf_preempted = 1;
+    else
+        dlist_push_right(ready, current_thread);
+    dccthread_switch(current_thread);
+
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+}
+
+// converte a fatia base para nanossegundos
+long timeslice_nsec(void)
+{
+    return timeslice.tv_sec * 1000000000L + timeslice.tv_nsec;
+}
+
+// relógio usado para medir tempos de espera e de serviço (virtual na simulação)
+long long dccthread_now_ns(void)
+{
+#ifdef DCCTHREAD_SIM
+    return sim_now;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#endif
+}
+
+// relógio que o temporizador de preempção mede: o orçamento EDF é descontado
+// nele para que a conta bata com o temporizador que o faz valer
+long long preemption_now_ns(void)
+{
+#ifdef DCCTHREAD_SIM
+    return sim_now;
+#else
+    struct timespec ts;
+    clock_gettime(preemption_clock, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#endif
+}
+
+// programa o temporizador de preempção com uma fatia de `nsec` nanossegundos
+// (0 desarma o temporizador).  só faz a chamada de sistema se a fatia mudou
+void timer_arm(long nsec)
+{
+    if (!timer_created || nsec == armed_nsec)
+        return;
+
+    timerspec.it_value.tv_sec = nsec / 1000000000L;
+    timerspec.it_value.tv_nsec = nsec % 1000000000L;
+    timerspec.it_interval = timerspec.it_value;
+
+    timer_settime(timer, 0, &timerspec, NULL);
+    armed_nsec = nsec;
+}
+
+// calcula a fatia do modo adaptativo para a próxima thread a executar:
+// se ela é a única executável o temporizador fica desarmado, e a fatia
+// diminui quando muitas threads recém-criadas estão na fila de prontas
+long adaptive_quantum(void)
+{
+    if (dlist_empty(ready))
+        return 0;
+
+    long nsec = timeslice_nsec();
+    long min = nsec < ADAPTIVE_MIN_NSEC ? nsec : ADAPTIVE_MIN_NSEC;
+    for (int fresh = nfresh; fresh >= ADAPTIVE_FRESH_STEP && nsec > min; fresh /= 2)
+        nsec /= 2;
+
+    return nsec < min ? min : nsec;
+}
+
+// garante que o temporizador está armado quando uma nova thread se torna
+// executável enquanto outra roda sozinha no modo adaptativo
+void timer_rearm_if_idle(void)
+{
+    if (adaptive && armed_nsec == 0)
+        timer_arm(timeslice_nsec());
 }
 
 // função auxiliar que inicializa os atributos das variáveis de suporte à preempção declaradas anteriormente
 // cria o temporizador de acordo com essas variáveis
-void timer_init()
+int timer_init()
 {
     action.sa_flags = 0;
     action.sa_handler = dccthread_preemption;
@@ -121,216 +353,1639 @@ void timer_init()
     signalevent.sigev_signo = SIGRTMIN;
     signalevent.sigev_value.sival_ptr = &timer;
 
-    timer_create(CLOCK_PROCESS_CPUTIME_ID, &signalevent, &timer);
+    if (timer_create(preemption_clock, &signalevent, &timer) == -1)
+        return -1;
 
-    timerspec.it_value.tv_sec = SEC_VALUE;
-    timerspec.it_value.tv_nsec = NSEC_VALUE;
-    timerspec.it_interval.tv_sec = SEC_VALUE;
-    timerspec.it_interval.tv_nsec = NSEC_VALUE;
+    timer_created = 1;
+    armed_nsec = -1;
 
-    timer_settime(timer, 0, &timerspec, NULL);
+    // no modo adaptativo o temporizador é programado a cada escalonamento
+    if (!adaptive)
+        timer_arm(timeslice_nsec());
+
+    return 0;
+}
+
+// lê a configuração da preempção das variáveis de ambiente, se presentes
+void timer_config_from_env(void)
+{
+    char *value;
+
+    if ((value = getenv("DCCTHREAD_TIMESLICE_NS")) != NULL && atol(value) > 0)
+    {
+        timeslice.tv_sec = atol(value) / 1000000000L;
+        timeslice.tv_nsec = atol(value) % 1000000000L;
+    }
+
+    if ((value = getenv("DCCTHREAD_CLOCK")) != NULL)
+    {
+        if (strcmp(value, "process") == 0)
+            preemption_clock = CLOCK_PROCESS_CPUTIME_ID;
+        else if (strcmp(value, "thread") == 0)
+            preemption_clock = CLOCK_THREAD_CPUTIME_ID;
+        else if (strcmp(value, "monotonic") == 0)
+            preemption_clock = CLOCK_MONOTONIC;
+        else if (strcmp(value, "realtime") == 0)
+            preemption_clock = CLOCK_REALTIME;
+    }
+
+    if ((value = getenv("DCCTHREAD_ADAPTIVE")) != NULL)
+        adaptive = atoi(value) != 0;
+}
+
+// os ajustes abaixo podem ser feitos antes de dccthread_init, quando quem chama
+// não está em uma thread da biblioteca: a máscara anterior é restaurada em vez
+// de o sinal ser desbloqueado, para não deixá-lo bloqueado nem liberá-lo à toa
+void dccthread_set_timeslice(struct timespec ts)
+{
+    sigset_t old;
+    sigprocmask(SIG_BLOCK, &mask, &old);
+
+    if (ts.tv_sec > 0 || ts.tv_nsec > 0)
+        timeslice = ts;
+
+    armed_nsec = -1;
+    if (!adaptive)
+        timer_arm(timeslice_nsec());
+
+    sigprocmask(SIG_SETMASK, &old, NULL);
+}
+
+int dccthread_set_clock(clockid_t clock)
+{
+    sigset_t old;
+    sigprocmask(SIG_BLOCK, &mask, &old);
+
+    clockid_t previous = preemption_clock;
+    preemption_clock = clock;
+
+    if (timer_created)
+    {
+        timer_delete(timer);
+        timer_created = 0;
+        if (timer_init() == -1)
+        {
+            preemption_clock = previous;
+            timer_init();
+            sigprocmask(SIG_SETMASK, &old, NULL);
+            return -1;
+        }
+        // o orçamento EDF da thread corrente passa a ser contado no novo relógio
+        dispatched_at = preemption_now_ns();
+    }
+
+    sigprocmask(SIG_SETMASK, &old, NULL);
+    return 0;
+}
+
+void dccthread_set_adaptive(int enabled)
+{
+    sigset_t old;
+    sigprocmask(SIG_BLOCK, &mask, &old);
+
+    adaptive = enabled != 0;
+    armed_nsec = -1;
+    if (!adaptive)
+        timer_arm(timeslice_nsec());
+
+    sigprocmask(SIG_SETMASK, &old, NULL);
 }
 
 // inicializa os atributos das máscaras de sinal bloqueado declaradas anteriormente
+// as funções da biblioteca só bloqueiam a preempção: o tratador de SIGRTMAX não
+// mexe em nenhuma estrutura da biblioteca e pode ser entregue a qualquer momento
 void mask_init()
 {
     sigemptyset(&mask);
     sigaddset(&mask, SIGRTMIN);
-    sigaddset(&mask, SIGRTMAX);
 
     sigemptyset(&mask_sleep);
     sigaddset(&mask_sleep, SIGRTMAX);
+
+    // máscara do gerente ocioso: só o sinal de despertar pode ser entregue
+    sigemptyset(&mask_idle);
+    sigaddset(&mask_idle, SIGRTMIN);
 }
 
 // função auxiliar para encapsular as atribuições que devem ser realizadas na thread manager
 // aloca o espaço da thread na memória e inicializa seu nome e variáveis de contexto
 void manager_init(void)
 {
-    manager_thread = (dccthread_t *)malloc(sizeof(dccthread_t));
+    manager_thread = (dccthread_t *)calloc(1, sizeof(dccthread_t));
     strcpy(manager_thread->name, "manager_thread");
     manager_thread->context.uc_link = NULL;
-    manager_thread->context.uc_stack.ss_sp = manager_thread->stack;
-    manager_thread->context.uc_stack.ss_size = THREAD_STACK_SIZE;
-    manager_thread->context.uc_stack.ss_flags = 0;
     manager_thread->context.uc_sigmask = mask;
     getcontext(&manager_thread->context);
 }
 
-void dccthread_init(void (*func)(int), int param)
+// função auxiliar que todas as threads usam para devolver a CPU ao gerente
+// guarda a posição atual da pilha para o modo de cópia de pilha
+void dccthread_switch(dccthread_t *current_thread)
 {
-    waiting = dlist_create();
-    ready = dlist_create();
-    finished = dlist_create();
-
-    mask_init();
-    timer_init();
-    manager_init();
+    volatile char marker;
+    // se a thread está dentro de um gerador, a parte da pilha compartilhada em
+    // uso termina onde ela entrou no gerador
+    current_thread->stack_mark = current_thread->gen != NULL ? current_thread->gen_mark : (char *)&marker;
+    swapcontext(&current_thread->context, &manager_thread->context);
+}
 
-    main_thread = dccthread_create("main", func, param);
-    sigprocmask(SIG_BLOCK, &mask, NULL);
+// ponto de cancelamento: se a thread corrente foi cancelada, executa os tratadores
+// de limpeza na ordem inversa em que foram empilhados e termina a thread
+// deve ser chamada com os sinais bloqueados; só retorna se não há cancelamento pendente
+void cancel_point(dccthread_t *current_thread)
+{
+    if (!current_thread->cancel_pending)
+        return;
 
-    while (!dlist_empty(ready) || !dlist_empty(waiting))
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+    while (current_thread->cleanup != NULL)
     {
-        sigprocmask(SIG_UNBLOCK, &mask_sleep, NULL);
-        sigprocmask(SIG_BLOCK, &mask_sleep, NULL);
+        dccthread_cleanup *handler = current_thread->cleanup;
+        current_thread->cleanup = handler->next;
+        handler->routine(handler->arg);
+        free(handler);
+    }
+    dccthread_exit();
+}
+
+// bloqueia a thread corrente na lista `queue` até que dccthread_unblock a acorde
+// deve ser chamada com os sinais bloqueados
+void dccthread_block(struct dlist *queue)
+{
+    dccthread_t *current_thread = main_thread;
+    current_thread->blocked_on = queue;
+    dlist_push_right(queue, current_thread);
+    dccthread_switch(current_thread);
+    cancel_point(current_thread);
+}
+
+// acorda a primeira thread bloqueada em `queue`, colocando-a na lista de prontas
+// retorna 0 se não havia thread bloqueada.  deve ser chamada com os sinais bloqueados
+int dccthread_unblock(struct dlist *queue)
+{
+    dccthread_t *thread = (dccthread_t *)dlist_pop_left(queue);
+    if (thread == NULL)
+        return 0;
+
+    thread->blocked_on = NULL;
+    dlist_push_right(ready, thread);
+    timer_rearm_if_idle();
+    return 1;
+}
+
+// ponto de entrada de todas as threads: executa a função e encerra a thread
+// quando ela retorna, para que o término seja sempre registrado
+void dccthread_start(void)
+{
+    dccthread_t *current_thread = dccthread_self();
+    // uma thread cancelada antes de ser escalonada nem chega a executar func
+    cancel_point(current_thread);
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+    current_thread->func(current_thread->param);
+    dccthread_exit();
+}
 
-        main_thread = (dccthread_t *)dlist_pop_left(ready);
+// copia a parte viva da pilha compartilhada de `thread` para um buffer do
+// tamanho exato utilizado, liberando a pilha compartilhada para outra thread
+void stack_save(dccthread_t *thread)
+{
+    char *top = shared_stack + THREAD_STACK_SIZE;
+    char *low = thread->stack_mark - STACK_COPY_SLACK;
+    if (low < shared_stack)
+        low = shared_stack;
 
-        if (main_thread->waiting_for != NULL)
+    size_t size = top - low;
+    if (size > thread->saved_capacity || size < thread->saved_capacity / 2)
+    {
+        char *saved = realloc(thread->saved_stack, size);
+        if (saved != NULL)
         {
-            if (is_thread_in_list(ready, main_thread->waiting_for) || is_thread_in_list(waiting, main_thread->waiting_for))
-            {
-                dlist_push_right(ready, main_thread);
-                continue;
-            }
-            else
-            {
-                main_thread->waiting_for = NULL;
-            }
+            thread->saved_stack = saved;
+            thread->saved_capacity = size;
+        }
+        else if (size > thread->saved_capacity)
+        {
+            // sem onde guardar a pilha, a thread não pode deixar a pilha compartilhada
+            fprintf(stderr, "dccthread: out of memory saving the stack of %s\n", thread->name);
+            exit(EXIT_FAILURE);
         }
-        swapcontext(&manager_thread->context, &main_thread->context);
     }
+    memcpy(thread->saved_stack, low, size);
+    thread->saved_size = size;
+}
 
-    dlist_destroy(ready, NULL);
-    dlist_destroy(waiting, NULL);
-    dlist_destroy(finished, NULL);
+// prepara a pilha compartilhada para executar `thread`: salva a thread que a
+// ocupa e restaura (ou cria, na primeira execução) o contexto de `thread`
+void stack_switch_in(dccthread_t *thread)
+{
+    if (stack_owner == thread)
+        return;
 
-    free(manager_thread);
-    free(main_thread);
+    if (stack_owner != NULL && !stack_owner->exited)
+        stack_save(stack_owner);
+    stack_owner = thread;
+
+    if (!thread->dispatched)
+    {
+        getcontext(&thread->context);
+        thread->context.uc_link = &manager_thread->context;
+        thread->context.uc_stack.ss_sp = shared_stack;
+        thread->context.uc_stack.ss_size = THREAD_STACK_SIZE;
+        thread->context.uc_stack.ss_flags = 0;
+        thread->context.uc_sigmask = mask;
+        makecontext(&thread->context, dccthread_start, 0);
+        return;
+    }
 
-    timer_delete(timer);
+    memcpy(shared_stack + THREAD_STACK_SIZE - thread->saved_size, thread->saved_stack, thread->saved_size);
+}
+
+// libera os recursos de pilha de uma thread que terminou
+void stack_release(dccthread_t *thread)
+{
+    if (thread->slab != NULL)
+    {
+        if (--thread->slab->live == 0)
+        {
+            free(thread->slab->stacks);
+            free(thread->slab);
+        }
+        thread->slab = NULL;
+    }
+    else
+        free(thread->stack);
+    thread->stack = NULL;
+    free(thread->saved_stack);
+    thread->saved_stack = NULL;
+    thread->saved_size = thread->saved_capacity = 0;
+    if (stack_owner == thread)
+        stack_owner = NULL;
+}
 
+// ponto de entrada dos geradores: executa a função e marca o gerador como terminado
+void dcc_gen_start(void)
+{
+    dcc_gen_t *gen = main_thread->gen;
     sigprocmask(SIG_UNBLOCK, &mask, NULL);
+    gen->func(gen->param);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    gen = main_thread->gen;
+    gen->done = 1;
+    setcontext(&gen->caller);
+}
 
-    exit(EXIT_SUCCESS);
+dcc_gen_t *dcc_gen_create(void (*func)(int), int param)
+{
+    dcc_gen_t *gen = (dcc_gen_t *)calloc(1, sizeof(dcc_gen_t));
+    if (gen == NULL)
+        return NULL;
+
+    gen->stack = malloc(THREAD_STACK_SIZE);
+    if (gen->stack == NULL)
+    {
+        free(gen);
+        return NULL;
+    }
+    gen->func = func;
+    gen->param = param;
+    return gen;
 }
 
-dccthread_t *dccthread_create(const char *name, void (*func)(int), int param)
+int dcc_gen_next(dcc_gen_t *gen, void **value)
 {
+    if (gen->done)
+        return 0;
+
     sigprocmask(SIG_BLOCK, &mask, NULL);
 
-    dccthread_t *thread = (dccthread_t *)malloc(sizeof(dccthread_t));
-    getcontext(&(thread->context));
-    strcpy(thread->name, name);
+    // o contexto só é criado na primeira chamada, pela thread consumidora
+    if (!gen->started)
+    {
+        getcontext(&gen->context);
+        gen->context.uc_link = NULL;
+        gen->context.uc_stack.ss_sp = gen->stack;
+        gen->context.uc_stack.ss_size = THREAD_STACK_SIZE;
+        gen->context.uc_stack.ss_flags = 0;
+        gen->context.uc_sigmask = mask;
+        makecontext(&gen->context, dcc_gen_start, 0);
+        gen->started = 1;
+    }
 
-    thread->context.uc_link = &manager_thread->context;
-    thread->context.uc_stack.ss_sp = thread->stack;
-    thread->context.uc_stack.ss_size = THREAD_STACK_SIZE;
-    thread->context.uc_stack.ss_flags = 0;
-    thread->has_waited = 0;
-    thread->waiting_for = NULL;
-    sigemptyset(&thread->context.uc_sigmask);
+    dccthread_t *current_thread = main_thread;
+    volatile char marker;
+    if (current_thread->gen == NULL)
+        current_thread->gen_mark = (char *)&marker;
+    gen->parent = current_thread->gen;
+    current_thread->gen = gen;
 
-    makecontext(&(thread->context), (void (*)(void))func, 1, param);
+    swapcontext(&gen->caller, &gen->context);
 
-    dlist_push_right(ready, thread);
+    // a thread pode ter mudado enquanto o gerador executava (ele pode ser
+    // consumido por mais de uma thread), então main_thread é relido
+    main_thread->gen = gen->parent;
 
     sigprocmask(SIG_UNBLOCK, &mask, NULL);
 
-    return thread;
+    if (gen->done)
+        return 0;
+    if (value != NULL)
+        *value = gen->value;
+    return 1;
 }
 
-void dccthread_yield(void)
+void dcc_gen_yield(void *value)
 {
     sigprocmask(SIG_BLOCK, &mask, NULL);
 
-    dccthread_t *current_thread = dccthread_self();
-    dlist_push_right(ready, current_thread);
-    swapcontext(&(current_thread->context), &(manager_thread->context));
+    dcc_gen_t *gen = main_thread->gen;
+    if (gen != NULL)
+    {
+        gen->value = value;
+        swapcontext(&gen->context, &gen->caller);
+    }
 
     sigprocmask(SIG_UNBLOCK, &mask, NULL);
 }
 
-void dccthread_exit(void)
+void dcc_gen_destroy(dcc_gen_t *gen)
 {
-    sigprocmask(SIG_BLOCK, &mask, NULL);
+    free(gen->stack);
+    free(gen);
+}
 
-    dccthread_t *current_thread = dccthread_self();
-    dlist_push_right(finished, current_thread);
-    swapcontext(&(current_thread->context), &(manager_thread->context));
-    setcontext(&manager_thread->context);
+int dccthread_set_stack_mode(int mode)
+{
+    if (manager_thread != NULL)
+        return -1;
 
-    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+    stack_copy = mode == DCCTHREAD_STACK_COPY;
+    return 0;
 }
 
-void dccthread_wait(dccthread_t *tid)
+// confere em /sys/devices/system/cpu/online (lista como "0-3,6") se `cpu` está ativa
+int cpu_online(int cpu)
 {
-    sigprocmask(SIG_BLOCK, &mask, NULL);
+    FILE *file = fopen("/sys/devices/system/cpu/online", "r");
+    if (file == NULL)
+        return cpu == 0;
 
-    dccthread_t *current_thread = dccthread_self();
+    int first, last, online = 0;
+    char sep;
+    while (!online && fscanf(file, "%d", &first) == 1)
+    {
+        last = first;
+        if (fscanf(file, "%c", &sep) == 1 && sep == '-')
+        {
+            if (fscanf(file, "%d", &last) != 1)
+                break;
+            fscanf(file, "%c", &sep);
+        }
+        online = cpu >= first && cpu <= last;
+    }
 
-    if (tid == NULL) {return;}
+    fclose(file);
+    return online;
+}
 
-    tid->has_waited = 1;
-    current_thread->waiting_for = tid;
+int dccthread_set_cpu(int cpu)
+{
+    if (cpu == DCCTHREAD_CPU_CURRENT)
+        cpu = sched_getcpu();
+    if (cpu < 0 || cpu >= CPU_SETSIZE || !cpu_online(cpu))
+        return -1;
+
+    // todas as threads da biblioteca executam na mesma thread do kernel, então
+    // fixá-la em um núcleo mantém as caches aquecidas entre as trocas de contexto
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) == -1)
+        return -1;
+    return cpu;
+}
 
-    dlist_push_right(ready, current_thread);
-    swapcontext(&current_thread->context, &manager_thread->context);
+// tratador de SIGPROF: reserva uma posição do buffer sem travas e guarda a
+// thread corrente e sua pilha de chamadas
+void dccthread_prof_sample(int _)
+{
+    int idx = __atomic_fetch_add(&prof_next, 1, __ATOMIC_RELAXED);
+    if (idx >= PROF_MAX_SAMPLES)
+    {
+        __atomic_fetch_add(&prof_dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
 
-    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+    dccthread_sample *sample = &prof_samples[idx];
+    sample->thread = in_manager ? manager_thread : main_thread;
+    sample->depth = backtrace(sample->pcs, PROF_MAX_DEPTH);
 }
 
-// implementação da definição de cmp declarada e especificada em dlist.h
-int dccthread_compare(const void *e1, const void *e2, void *userdata)
+int dccthread_prof_start(int hz)
 {
-    return e1 != e2;
+    if (hz <= 0 || hz > 1000000)
+        return -1;
+
+    if (prof_samples == NULL)
+        prof_samples = calloc(PROF_MAX_SAMPLES, sizeof(dccthread_sample));
+    if (prof_samples == NULL)
+        return -1;
+    prof_next = 0;
+    prof_dropped = 0;
+
+    // a primeira chamada de backtrace pode alocar memória; não deve acontecer no tratador
+    void *warmup[1];
+    backtrace(warmup, 1);
+
+    struct sigaction prof_action;
+    prof_action.sa_flags = SA_RESTART;
+    prof_action.sa_handler = dccthread_prof_sample;
+    prof_action.sa_mask = mask;
+    sigaction(SIGPROF, &prof_action, NULL);
+
+    struct itimerval interval;
+    interval.it_interval.tv_sec = 0;
+    interval.it_interval.tv_usec = 1000000 / hz;
+    interval.it_value = interval.it_interval;
+    return setitimer(ITIMER_PROF, &interval, NULL);
 }
 
-// função auxiliar para tratar o caso do fim de tempo de sono de uma thread (acordar a thread)
-// remove a thread da lista de espera e adiciona à lista de prontas
-void dccthread_wakeup(int signo, siginfo_t *si, void *context)
+void dccthread_prof_stop(void)
 {
-    dccthread_t *sleeping_thread = (dccthread_t *)si->si_value.sival_ptr;
-    dlist_find_remove(waiting, sleeping_thread, dccthread_compare, NULL);
-    dlist_push_right(ready, sleeping_thread);
+    struct itimerval interval;
+    memset(&interval, 0, sizeof(interval));
+    setitimer(ITIMER_PROF, &interval, NULL);
 }
 
-// função auxiliar que inicializa o temporizador de sono, semelhante à timer_init
-// porém, dessa vez, a ação não é tirar a thread da CPU (yield) e sim acordá-la (wakeup)
-void timer_sleep_init(timer_t *timer_id, struct timespec *ts)
+// extrai o nome da função de uma linha de backtrace_symbols ("bin(func+0x1f) [0x...]"),
+// usando o endereço quando o símbolo não está disponível
+void prof_symbol(const char *line, void *pc, char *out, size_t size)
 {
-    // Configurar o manipulador de sinal para o temporizador
-    action_sleep.sa_flags = SA_SIGINFO;
-    action_sleep.sa_sigaction = dccthread_wakeup; //acordo a thread ao invés de retirá-la
-    action_sleep.sa_mask = mask;
-    sigaction(SIGRTMAX, &action_sleep, NULL);
+    const char *begin = strchr(line, '(');
+    const char *end = begin != NULL ? strpbrk(begin, "+)") : NULL;
+    if (begin != NULL && end != NULL && end > begin + 1)
+        snprintf(out, size, "%.*s", (int)(end - begin - 1), begin + 1);
+    else
+        snprintf(out, size, "%p", pc);
+}
 
-    signalevent_sleep.sigev_notify = SIGEV_SIGNAL;
-    signalevent_sleep.sigev_signo = SIGRTMAX;
-    signalevent_sleep.sigev_value.sival_ptr = main_thread;
+int prof_compare_lines(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+int dccthread_prof_dump(FILE *out)
+{
+    int nsamples = prof_next < PROF_MAX_SAMPLES ? prof_next : PROF_MAX_SAMPLES;
+    char **lines = malloc((nsamples + 1) * sizeof(char *));
+    int nlines = 0;
+    int dropped = prof_dropped;
+    if (lines == NULL)
+        return -1;
+
+    // monta uma linha "thread;mais_externa;...;mais_interna" por amostra
+    for (int i = 0; i < nsamples; i++)
+    {
+        dccthread_sample *sample = &prof_samples[i];
+        if (sample->thread == NULL || sample->depth <= PROF_SKIP_FRAMES)
+            continue;
+
+        size_t size = DCCTHREAD_MAX_NAME_SIZE + (size_t)sample->depth * 64;
+        char *line = malloc(size);
+        // sem memória para a linha, a amostra conta como descartada
+        if (line == NULL)
+        {
+            dropped++;
+            continue;
+        }
+        char **symbols = backtrace_symbols(sample->pcs, sample->depth);
+        size_t len = snprintf(line, size, "%s", dccthread_name(sample->thread));
+        for (int f = sample->depth - 1; f >= PROF_SKIP_FRAMES && len < size; f--)
+        {
+            char name[64];
+            prof_symbol(symbols != NULL ? symbols[f] : "", sample->pcs[f], name, sizeof(name));
+            len += snprintf(line + len, size - len, ";%s", name);
+        }
+        free(symbols);
+        lines[nlines++] = line;
+    }
+
+    // agrupa as linhas iguais no formato "collapsed stack" usado por flamegraph.pl
+    qsort(lines, nlines, sizeof(char *), prof_compare_lines);
+    for (int i = 0; i < nlines;)
+    {
+        int j = i;
+        while (j < nlines && strcmp(lines[i], lines[j]) == 0)
+            j++;
+        fprintf(out, "%s %d\n", lines[i], j - i);
+        i = j;
+    }
 
-    timer_create(CLOCK_REALTIME, &signalevent_sleep, timer_id);
+    for (int i = 0; i < nlines; i++)
+        free(lines[i]);
+    free(lines);
+    return dropped;
+}
 
-    timerspec_sleep.it_value.tv_sec = ts->tv_sec;
-    timerspec_sleep.it_value.tv_nsec = ts->tv_nsec;
-    timerspec_sleep.it_interval.tv_sec = SEC_VALUE;
-    timerspec_sleep.it_interval.tv_nsec = NSEC_VALUE;
+#ifdef DCCTHREAD_SIM
 
-    timer_settime(*timer_id, 0, &timerspec_sleep, NULL);
+// acorda, em ordem de prazo, as threads cujo prazo já passou no relógio virtual
+void sim_wakeup_expired(void)
+{
+    for (;;)
+    {
+        dccthread_t *earliest = NULL;
+        for (int i = 0; i < waiting->count; i++)
+        {
+            dccthread_t *thread = dlist_get_index(waiting, i);
+            if (thread->wake_at <= sim_now && (earliest == NULL || thread->wake_at < earliest->wake_at))
+                earliest = thread;
+        }
+        if (earliest == NULL)
+            return;
+        dlist_find_remove(waiting, earliest, dccthread_compare, NULL);
+        dlist_push_right(ready, earliest);
+    }
 }
 
-void dccthread_sleep(struct timespec ts)
+// avança o relógio virtual direto para o prazo da próxima thread dormindo
+void sim_jump(void)
 {
-    sigprocmask(SIG_BLOCK, &mask, NULL);
+    if (dlist_empty(waiting))
+    {
+        fprintf(stderr, "dccthread: deadlock at virtual time %lld ns\n", sim_now);
+        exit(EXIT_FAILURE);
+    }
 
-    dccthread_timer timer;
-    timer.sleep_time = ts;
-    timer_sleep_init(&timer.timer_id, &ts);
+    long long next = ((dccthread_t *)dlist_get_index(waiting, 0))->wake_at;
+    for (int i = 1; i < waiting->count; i++)
+    {
+        dccthread_t *thread = dlist_get_index(waiting, i);
+        if (thread->wake_at < next)
+            next = thread->wake_at;
+    }
+    if (next > sim_now)
+        sim_now = next;
+    sim_wakeup_expired();
+}
 
-    dlist_push_right(waiting, main_thread);
-    swapcontext(&main_thread->context, &manager_thread->context);
+// escolhe a próxima thread: FIFO sem semente, ou sorteio reproduzível com semente
+dccthread_t *sim_pick(void)
+{
+    if (sim_state == 0 || ready->count == 1)
+        return dlist_pop_left(ready);
 
-    timer_delete(timer.timer_id);
+    sim_state = sim_state * 6364136223846793005ULL + 1442695040888963407ULL;
+    dccthread_t *thread = dlist_get_index(ready, (int)((sim_state >> 33) % ready->count));
+    return dlist_find_remove(ready, thread, dccthread_compare, NULL);
+}
 
-    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+void dccthread_sim_seed(unsigned seed)
+{
+    sim_state = seed;
+    sim_seeded = 1;
 }
 
-dccthread_t *dccthread_self(void)
+struct timespec dccthread_sim_time(void)
 {
-    return main_thread;
+    struct timespec ts;
+    ts.tv_sec = sim_now / 1000000000LL;
+    ts.tv_nsec = sim_now % 1000000000LL;
+    return ts;
 }
+#endif
 
-const char *dccthread_name(dccthread_t *tid)
+// contador de ciclos usado na contabilidade de CPU: o TSC em x86, ou o relógio
+// monotônico em nanossegundos nas demais arquiteturas
+unsigned long long cpu_ticks_now(void)
 {
-    return tid->name;
-}
\ No newline at end of file
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#endif
+}
+
+// ciclos do TSC por nanossegundo, medidos desde dccthread_init.  a razão é
+// guardada na primeira chamada feita depois de 1 ms; antes disso é calculada
+// com o intervalo que já passou, sem esperar
+double cpu_ticks_per_ns(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (ticks_per_ns > 0)
+        return ticks_per_ns;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    unsigned long long ticks = cpu_ticks_now() - ticks_origin;
+    long long ns = ts.tv_sec * 1000000000LL + ts.tv_nsec - ticks_origin_ns;
+    if (ns < 1)
+        ns = 1;
+    if (ns < 1000000)
+        return (double)ticks / ns;
+    ticks_per_ns = (double)ticks / ns;
+    return ticks_per_ns;
+#else
+    return 1.0;
+#endif
+}
+
+// tratador de SIGRTMAX: empilha a thread na pilha de despertares com
+// compare-and-swap, o que é seguro em um tratador de sinal e entre threads do kernel
+void dccthread_wakeup(int signo, siginfo_t *si, void *context)
+{
+    dccthread_t *sleeping_thread = (dccthread_t *)si->si_value.sival_ptr;
+
+    // um sinal atrasado de um temporizador já removido não empilha a thread duas vezes
+    if (__atomic_exchange_n(&sleeping_thread->wake_queued, 1, __ATOMIC_ACQ_REL))
+        return;
+
+    dccthread_t *head = __atomic_load_n(&wakeups, __ATOMIC_RELAXED);
+    do
+        sleeping_thread->wake_next = head;
+    while (!__atomic_compare_exchange_n(&wakeups, &head, sleeping_thread, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    // no modo adaptativo a thread em execução pode estar sem temporizador, e uma
+    // thread EDF tem prioridade sobre a que está executando: força uma preempção
+    // para que o gerente veja o despertar
+    if ((adaptive && armed_nsec == 0) || sleeping_thread->edf_period)
+        raise(SIGRTMIN);
+}
+
+// função auxiliar que inicializa o temporizador de sono, semelhante à timer_init
+// porém, dessa vez, a ação não é tirar a thread da CPU (yield) e sim acordá-la (wakeup)
+void timer_sleep_init(dccthread_t *thread, struct timespec *ts)
+{
+    // Configurar o manipulador de sinal para o temporizador
+    action_sleep.sa_flags = SA_SIGINFO;
+    action_sleep.sa_sigaction = dccthread_wakeup; //acordo a thread ao invés de retirá-la
+    action_sleep.sa_mask = mask;
+    sigaction(SIGRTMAX, &action_sleep, NULL);
+
+    signalevent_sleep.sigev_notify = SIGEV_SIGNAL;
+    signalevent_sleep.sigev_signo = SIGRTMAX;
+    signalevent_sleep.sigev_value.sival_ptr = thread;
+
+    timer_create(CLOCK_REALTIME, &signalevent_sleep, &thread->sleep_timer);
+
+    timerspec_sleep.it_value.tv_sec = ts->tv_sec;
+    timerspec_sleep.it_value.tv_nsec = ts->tv_nsec;
+    timerspec_sleep.it_interval.tv_sec = 0;
+    timerspec_sleep.it_interval.tv_nsec = 0;
+
+    timer_settime(thread->sleep_timer, 0, &timerspec_sleep, NULL);
+    thread->sleeping = 1;
+}
+
+// inicia o job da classe EDF liberado no instante `release`
+void edf_new_job(dccthread_t *thread, long long release)
+{
+    thread->edf_release = release;
+    thread->edf_abs_deadline = release + thread->edf_deadline;
+    thread->edf_budget = thread->edf_runtime;
+}
+
+// deixa a thread EDF fora da CPU até a próxima liberação do seu período; se a
+// liberação já passou, o próximo job começa na hora.  a thread não pode estar em
+// nenhuma lista.  executada pelo gerente
+void edf_throttle(dccthread_t *thread)
+{
+    long long next = thread->edf_release + thread->edf_period;
+    long long now = dccthread_now_ns();
+
+    if (next <= now)
+    {
+        edf_new_job(thread, now);
+        dlist_push_right(ready, thread);
+        return;
+    }
+
+    struct timespec ts = {(next - now) / 1000000000LL, (next - now) % 1000000000LL};
+    thread->edf_release = next;
+    thread->edf_throttled = 1;
+    dlist_push_right(waiting, thread);
+    timer_sleep_init(thread, &ts);
+}
+
+// desconta de uma thread EDF o tempo que ela passou na CPU e decide para onde ela
+// vai: um yield encerra o job, e uma preempção com o orçamento esgotado a segura
+// até o próximo período.  se ela dormiu ou bloqueou, o job continua ao acordar
+void edf_account(dccthread_t *thread)
+{
+    thread->edf_budget -= preemption_now_ns() - dispatched_at;
+    long long now = dccthread_now_ns();
+
+    if (thread->edf_done)
+    {
+        thread->edf_done = 0;
+        thread->edf_stats.jobs++;
+        long long lateness = now - thread->edf_abs_deadline;
+        if (lateness > 0)
+        {
+            thread->edf_stats.misses++;
+            if (lateness > thread->edf_stats.max_lateness_ns)
+                thread->edf_stats.max_lateness_ns = lateness;
+        }
+        edf_throttle(thread);
+    }
+    else if (thread->edf_preempted)
+    {
+        thread->edf_preempted = 0;
+        if (thread->edf_budget <= 0)
+        {
+            thread->edf_stats.overruns++;
+            edf_throttle(thread);
+        }
+        else
+            dlist_push_right(ready, thread);
+    }
+}
+
+// escolhe a próxima thread: a thread EDF pronta com o prazo mais próximo, ou a
+// primeira da fila de prontas se não há nenhuma
+dccthread_t *edf_pick(void)
+{
+    if (nedf == 0)
+        return (dccthread_t *)dlist_pop_left(ready);
+
+    dccthread_t *earliest = NULL;
+    for (int i = 0; i < ready->count; i++)
+    {
+        dccthread_t *thread = dlist_get_index(ready, i);
+        if (thread->edf_period && (earliest == NULL || thread->edf_abs_deadline < earliest->edf_abs_deadline))
+            earliest = thread;
+    }
+    if (earliest == NULL)
+        return (dccthread_t *)dlist_pop_left(ready);
+
+    dlist_find_remove(ready, earliest, dccthread_compare, NULL);
+    return earliest;
+}
+
+// densidade de uma thread EDF: fração da CPU que ela pode exigir
+double edf_density_of(long long period, long long runtime, long long deadline)
+{
+    return (double)runtime / (deadline < period ? deadline : period);
+}
+
+// retira a thread da classe EDF, devolvendo sua densidade
+void edf_leave(dccthread_t *thread)
+{
+    if (!thread->edf_period)
+        return;
+    edf_density -= edf_density_of(thread->edf_period, thread->edf_runtime, thread->edf_deadline);
+    thread->edf_period = 0;
+    nedf--;
+}
+
+int dccthread_set_deadline(struct timespec period, struct timespec runtime, struct timespec deadline)
+{
+#ifdef DCCTHREAD_SIM
+    // a simulação não tem temporizador de preempção para limitar o orçamento
+    return -1;
+#else
+    long long period_ns = period.tv_sec * 1000000000LL + period.tv_nsec;
+    long long runtime_ns = runtime.tv_sec * 1000000000LL + runtime.tv_nsec;
+    long long deadline_ns = deadline.tv_sec * 1000000000LL + deadline.tv_nsec;
+    if (deadline_ns == 0)
+        deadline_ns = period_ns;
+
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+
+    dccthread_t *current_thread = dccthread_self();
+    if (period_ns == 0)
+    {
+        edf_leave(current_thread);
+        sigprocmask(SIG_UNBLOCK, &mask, NULL);
+        return 0;
+    }
+
+    // controle de admissão: o conjunto só é escalonável se a soma das densidades
+    // (orçamento / min(prazo, período)) não passa de 1
+    double density = edf_density - (current_thread->edf_period ? edf_density_of(current_thread->edf_period, current_thread->edf_runtime, current_thread->edf_deadline) : 0);
+    if (runtime_ns <= 0 || runtime_ns > deadline_ns || deadline_ns > period_ns ||
+        density + edf_density_of(period_ns, runtime_ns, deadline_ns) > 1.0)
+    {
+        sigprocmask(SIG_UNBLOCK, &mask, NULL);
+        return -1;
+    }
+
+    edf_leave(current_thread);
+    current_thread->edf_period = period_ns;
+    current_thread->edf_runtime = runtime_ns;
+    current_thread->edf_deadline = deadline_ns;
+    edf_density += edf_density_of(period_ns, runtime_ns, deadline_ns);
+    nedf++;
+
+    // o primeiro job começa agora, e o orçamento é contado a partir deste ponto
+    dispatched_at = preemption_now_ns();
+    edf_new_job(current_thread, dccthread_now_ns());
+    armed_nsec = -1;
+    timer_arm(runtime_ns);
+
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+    return 0;
+#endif
+}
+
+int dccthread_deadline_stats(dccthread_t *tid, struct dccthread_deadline_stats *stats)
+{
+    if (tid == NULL || stats == NULL)
+        return -1;
+
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    *stats = tid->edf_stats;
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+    return 0;
+}
+
+// marca o cancelamento de `tid`, com o sinal já bloqueado.  uma thread parada
+// em um ponto de cancelamento volta para a fila de prontas imediatamente e
+// termina ao retomar; as demais terminam no próximo ponto.  não mexe na máscara
+// para poder ser chamada pelo gerente
+void cancel_request(dccthread_t *tid)
+{
+    tid->cancel_pending = 1;
+
+    if (tid->sleeping)
+    {
+#ifndef DCCTHREAD_SIM
+        timer_delete(tid->sleep_timer);
+#endif
+        tid->sleeping = 0;
+        // se o temporizador já disparou, wakeup_drain pode ter posto a thread em
+        // ready; ela só volta para lá se ainda estava em waiting
+        if (dlist_find_remove(waiting, tid, dccthread_compare, NULL) != NULL)
+        {
+            dlist_push_right(ready, tid);
+            timer_rearm_if_idle();
+        }
+    }
+    else if (tid->blocked_on != NULL)
+    {
+        dlist_find_remove(tid->blocked_on, tid, dccthread_compare, NULL);
+        tid->blocked_on = NULL;
+        dlist_push_right(ready, tid);
+        timer_rearm_if_idle();
+    }
+    else if (tid->join_remaining > 0)
+    {
+        // os registros nas threads esperadas são removidos pela própria thread ao acordar
+        tid->join_remaining = 0;
+        dlist_push_right(ready, tid);
+        timer_rearm_if_idle();
+    }
+}
+
+// aplica o limite de CPU de uma thread que acabou de sair da CPU e passou dele
+void cpu_limit_exceeded(dccthread_t *thread)
+{
+    thread->cpu_limit = 0;
+    if (thread->cpu_limit_action == DCCTHREAD_LIMIT_CANCEL)
+    {
+        cancel_request(thread);
+        return;
+    }
+
+    // rebaixada, a thread também perde a classe EDF.  uma thread EDF que cedeu a
+    // CPU ou foi preemptada não está em nenhuma lista, porque quem a recoloca é
+    // edf_account, que não roda mais para ela: volta para a fila de prontas aqui
+    if (thread->edf_done || thread->edf_preempted)
+    {
+        thread->edf_done = 0;
+        thread->edf_preempted = 0;
+        dlist_push_right(ready, thread);
+    }
+    edf_leave(thread);
+    thread->demoted = 1;
+}
+
+// esvazia a pilha de despertares, movendo as threads de waiting para a fila de
+// prontas na ordem em que os temporizadores dispararam.  executada pelo gerente
+void wakeup_drain(void)
+{
+    dccthread_t *stack = __atomic_exchange_n(&wakeups, NULL, __ATOMIC_ACQUIRE);
+    dccthread_t *fifo = NULL;
+
+    while (stack != NULL)
+    {
+        dccthread_t *next = stack->wake_next;
+        stack->wake_next = fifo;
+        fifo = stack;
+        stack = next;
+    }
+
+    while (fifo != NULL)
+    {
+        dccthread_t *next = fifo->wake_next;
+        __atomic_store_n(&fifo->wake_queued, 0, __ATOMIC_RELEASE);
+        // a thread pode já ter sido acordada por um cancelamento
+        if (dlist_find_remove(waiting, fifo, dccthread_compare, NULL) != NULL)
+        {
+            // uma thread EDF segurada até o próximo período volta com um job novo
+            if (fifo->edf_throttled)
+            {
+                timer_delete(fifo->sleep_timer);
+                fifo->sleeping = 0;
+                fifo->edf_throttled = 0;
+                edf_new_job(fifo, fifo->edf_release);
+            }
+            dlist_push_right(ready, fifo);
+        }
+        fifo = next;
+    }
+}
+
+void dccthread_init(void (*func)(int), int param)
+{
+    waiting = dlist_create();
+    ready = dlist_create();
+    finished = dlist_create();
+    background = dlist_create();
+
+    // a calibração do TSC usa o relógio real, mesmo na simulação
+    struct timespec origin;
+    clock_gettime(CLOCK_MONOTONIC, &origin);
+    ticks_origin_ns = origin.tv_sec * 1000000000LL + origin.tv_nsec;
+    ticks_origin = cpu_ticks_now();
+
+    mask_init();
+    timer_config_from_env();
+#ifdef DCCTHREAD_SIM
+    // a simulação não usa preempção por tempo real, para ser determinística
+    if (!sim_seeded && getenv("DCCTHREAD_SIM_SEED") != NULL)
+        sim_state = strtoull(getenv("DCCTHREAD_SIM_SEED"), NULL, 10);
+#else
+    timer_init();
+#endif
+
+    if (getenv("DCCTHREAD_CPU") != NULL)
+        dccthread_set_cpu(strcmp(getenv("DCCTHREAD_CPU"), "current") == 0 ? DCCTHREAD_CPU_CURRENT : atoi(getenv("DCCTHREAD_CPU")));
+
+    if (getenv("DCCTHREAD_STACK_COPY") != NULL && atoi(getenv("DCCTHREAD_STACK_COPY")) != 0)
+        stack_copy = 1;
+    if (stack_copy)
+    {
+        shared_stack = malloc(THREAD_STACK_SIZE);
+        // sem a pilha compartilhada, cada thread recebe a sua
+        if (shared_stack == NULL)
+            stack_copy = 0;
+    }
+
+    manager_init();
+
+    main_thread = dccthread_create("main", func, param);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    // o gerente recebe despertares só em pontos conhecidos, para não perder um
+    // sinal entre conferir a fila de prontas e suspender
+    sigprocmask(SIG_BLOCK, &mask_sleep, NULL);
+    in_manager = 1;
+
+    while (!dlist_empty(ready) || !dlist_empty(waiting) || !dlist_empty(background) || donated != NULL)
+    {
+#ifdef DCCTHREAD_SIM
+        sim_now += SIM_TICK_NSEC;
+        sim_wakeup_expired();
+        if (dlist_empty(ready) && !dlist_empty(background))
+            dlist_push_right(ready, dlist_pop_left(background));
+        if (dlist_empty(ready))
+            sim_jump();
+
+        main_thread = donated != NULL ? donated : sim_pick();
+#else
+        sigprocmask(SIG_UNBLOCK, &mask_sleep, NULL);
+        sigprocmask(SIG_BLOCK, &mask_sleep, NULL);
+        wakeup_drain();
+        // threads rebaixadas só executam quando nenhuma outra está pronta
+        if (dlist_empty(ready) && donated == NULL && !dlist_empty(background))
+            dlist_push_right(ready, dlist_pop_left(background));
+
+        // todas as threads estão dormindo ou bloqueadas: espera o próximo despertar
+        if (dlist_empty(ready) && donated == NULL)
+        {
+            sigsuspend(&mask_idle);
+            continue;
+        }
+
+        main_thread = donated != NULL ? donated : edf_pick();
+
+        // uma thread EDF que bloqueou com o orçamento esgotado espera o próximo período
+        if (main_thread->edf_period && main_thread->edf_budget <= 0)
+        {
+            main_thread->edf_stats.overruns++;
+            edf_throttle(main_thread);
+            continue;
+        }
+#endif
+
+        if (stack_copy)
+            stack_switch_in(main_thread);
+        if (!main_thread->dispatched)
+        {
+            main_thread->dispatched = 1;
+            nfresh--;
+        }
+        if (main_thread->edf_period)
+        {
+            // a thread EDF é preemptada quando o orçamento do job acaba
+            armed_nsec = -1;
+            timer_arm(main_thread->edf_budget);
+        }
+        else if (main_thread == donated)
+        {
+            // a thread recebe o que resta da fatia de quem cedeu a CPU: o
+            // temporizador não é reprogramado, a menos que esteja desarmado
+            if (armed_nsec == 0)
+                timer_arm(adaptive_quantum());
+        }
+        else if (adaptive)
+            timer_arm(adaptive_quantum());
+        else
+            timer_arm(timeslice_nsec());
+        if (nedf > 0)
+            dispatched_at = preemption_now_ns();
+        donated = NULL;
+        in_manager = 0;
+        unsigned long long ticks = cpu_ticks_now();
+        swapcontext(&manager_thread->context, &main_thread->context);
+        main_thread->cpu_ticks += cpu_ticks_now() - ticks;
+        in_manager = 1;
+
+        if (main_thread->cpu_limit && main_thread->cpu_ticks > main_thread->cpu_limit && !main_thread->exited)
+            cpu_limit_exceeded(main_thread);
+        // uma thread rebaixada que voltou para a fila de prontas vai para o fim da fila de fundo
+        if (main_thread->demoted && dlist_get_index(ready, -1) == main_thread)
+            dlist_push_right(background, dlist_pop_right(ready));
+
+        if (main_thread->exited)
+            stack_release(main_thread);
+        else if (main_thread->edf_period)
+            edf_account(main_thread);
+    }
+
+    dlist_destroy(ready, NULL);
+    dlist_destroy(waiting, NULL);
+    dlist_destroy(finished, NULL);
+    dlist_destroy(background, NULL);
+
+    free(manager_thread);
+    free(shared_stack);
+
+    if (timer_created)
+        timer_delete(timer);
+
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+
+    exit(EXIT_SUCCESS);
+}
+
+// cria uma thread e a coloca na lista de prontas; deve ser chamada com os sinais bloqueados
+dccthread_t *thread_new(const char *name, void (*func)(int), int param)
+{
+    dccthread_t *thread = (dccthread_t *)calloc(1, sizeof(dccthread_t));
+    strcpy(thread->name, name);
+    thread->func = func;
+    thread->param = param;
+
+    // no modo de cópia de pilha o contexto só é criado na primeira execução,
+    // diretamente sobre a pilha compartilhada
+    if (!stack_copy)
+    {
+        thread->stack = malloc(THREAD_STACK_SIZE);
+        getcontext(&(thread->context));
+        thread->context.uc_link = &manager_thread->context;
+        thread->context.uc_stack.ss_sp = thread->stack;
+        thread->context.uc_stack.ss_size = THREAD_STACK_SIZE;
+        thread->context.uc_stack.ss_flags = 0;
+        thread->context.uc_sigmask = mask;
+        makecontext(&(thread->context), dccthread_start, 0);
+    }
+
+    dlist_push_right(ready, thread);
+    nfresh++;
+    timer_rearm_if_idle();
+
+    return thread;
+}
+
+dccthread_t *dccthread_create(const char *name, void (*func)(int), int param)
+{
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+
+    dccthread_t *thread = thread_new(name, func, param);
+
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+
+    return thread;
+}
+
+// copia o contexto modelo de um lote para `context`.  na glibc x86-64 o contexto
+// aponta para a sua própria área de ponto flutuante, que precisa ser corrigida
+// após a cópia; nas demais plataformas o contexto é obtido com getcontext
+void context_from_template(ucontext_t *context, const ucontext_t *template)
+{
+#if defined(__x86_64__) && defined(__GLIBC__)
+    *context = *template;
+    context->uc_mcontext.fpregs = &context->__fpregs_mem;
+#else
+    getcontext(context);
+    context->uc_link = template->uc_link;
+    context->uc_stack = template->uc_stack;
+    context->uc_sigmask = template->uc_sigmask;
+#endif
+}
+
+int dccthread_create_batch(const struct dccthread_spec *specs, int n, dccthread_t **out)
+{
+    if (n <= 0)
+        return 0;
+
+    // descritores e pilhas em dois blocos: os descritores ficam para sempre, como
+    // os de dccthread_create, e as pilhas são liberadas com o fim do lote
+    dccthread_t *threads = (dccthread_t *)calloc(n, sizeof(dccthread_t));
+    dccthread_slab *slab = NULL;
+    if (threads != NULL && !stack_copy)
+    {
+        slab = (dccthread_slab *)malloc(sizeof(dccthread_slab));
+        if (slab != NULL && (slab->stacks = malloc((size_t)n * BATCH_STACK_STRIDE)) == NULL)
+        {
+            free(slab);
+            slab = NULL;
+        }
+        if (slab == NULL)
+        {
+            free(threads);
+            threads = NULL;
+        }
+    }
+    if (threads == NULL)
+        return -1;
+
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+
+    // um único getcontext serve de modelo para todos os contextos do lote
+    ucontext_t template;
+    if (slab != NULL)
+    {
+        slab->live = n;
+        getcontext(&template);
+        template.uc_link = &manager_thread->context;
+        template.uc_stack.ss_flags = 0;
+        template.uc_stack.ss_size = THREAD_STACK_SIZE;
+        template.uc_sigmask = mask;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        dccthread_t *thread = &threads[i];
+        strcpy(thread->name, specs[i].name);
+        thread->func = specs[i].func;
+        thread->param = specs[i].param;
+        out[i] = thread;
+
+        if (slab != NULL)
+        {
+            thread->slab = slab;
+            thread->stack = slab->stacks + (size_t)i * BATCH_STACK_STRIDE;
+            context_from_template(&thread->context, &template);
+            thread->context.uc_stack.ss_sp = thread->stack;
+            makecontext(&thread->context, dccthread_start, 0);
+        }
+    }
+
+    dlist_push_right_array(ready, (void **)out, n);
+    nfresh += n;
+    timer_rearm_if_idle();
+
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+
+    return n;
+}
+
+void dccthread_yield(void)
+{
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+
+    dccthread_t *current_thread = dccthread_self();
+    cancel_point(current_thread);
+    // na classe EDF o yield encerra o job corrente
+    if (current_thread->edf_period)
+        current_thread->edf_done = 1;
+    else
+        dlist_push_right(ready, current_thread);
+    dccthread_switch(current_thread);
+    cancel_point(current_thread);
+
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+}
+
+int dccthread_yield_to(dccthread_t *tid)
+{
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+
+    dccthread_t *current_thread = dccthread_self();
+    cancel_point(current_thread);
+
+    // só uma thread na fila de prontas pode receber a CPU diretamente
+    if (tid == NULL || tid == current_thread || dlist_find_remove(ready, tid, dccthread_compare, NULL) == NULL)
+    {
+        sigprocmask(SIG_UNBLOCK, &mask, NULL);
+        dccthread_yield();
+        return -1;
+    }
+
+    donated = tid;
+    // uma thread EDF continua o job corrente ao voltar para a fila
+    if (current_thread->edf_period)
+        current_thread->edf_preempted = 1;
+    else
+        dlist_push_right(ready, current_thread);
+    dccthread_switch(current_thread);
+    cancel_point(current_thread);
+
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+    return 0;
+}
+
+void dccthread_exit(void)
+{
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+
+    dccthread_t *current_thread = dccthread_self();
+    current_thread->exited = 1;
+    edf_leave(current_thread);
+    dlist_push_right(finished, current_thread);
+
+    // acorda as threads cuja espera termina com esta thread
+    if (current_thread->joiners != NULL)
+    {
+        dccthread_t *joiner;
+        while ((joiner = (dccthread_t *)dlist_pop_left(current_thread->joiners)) != NULL)
+        {
+            if (--joiner->join_remaining == 0)
+            {
+                dlist_push_right(ready, joiner);
+                timer_rearm_if_idle();
+            }
+        }
+        dlist_destroy(current_thread->joiners, NULL);
+        current_thread->joiners = NULL;
+    }
+
+    dccthread_switch(current_thread);
+    setcontext(&manager_thread->context);
+
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+}
+
+// registra a thread corrente como interessada no término de `tid`
+void join_register(dccthread_t *current_thread, dccthread_t *tid)
+{
+    if (tid->joiners == NULL)
+        tid->joiners = dlist_create();
+    dlist_push_right(tid->joiners, current_thread);
+}
+
+// remove os registros de espera que sobraram nas threads que ainda não terminaram
+void join_unregister(dccthread_t *current_thread, dccthread_t **threads, int n)
+{
+    for (int i = 0; i < n; i++)
+        if (threads[i] != NULL && !threads[i]->exited && threads[i]->joiners != NULL)
+            dlist_find_remove(threads[i]->joiners, current_thread, dccthread_compare, NULL);
+}
+
+void dccthread_wait_all(dccthread_t **threads, int n)
+{
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+
+    dccthread_t *current_thread = dccthread_self();
+    int remaining = 0;
+
+    cancel_point(current_thread);
+
+    for (int i = 0; i < n; i++)
+    {
+        if (threads[i] == NULL || threads[i] == current_thread)
+            continue;
+        threads[i]->has_waited = 1;
+        if (!threads[i]->exited)
+        {
+            join_register(current_thread, threads[i]);
+            remaining++;
+        }
+    }
+
+    // a thread sai da CPU uma única vez; a última thread a terminar a acorda
+    if (remaining > 0)
+    {
+        current_thread->join_remaining = remaining;
+        dccthread_switch(current_thread);
+
+        if (current_thread->cancel_pending)
+        {
+            join_unregister(current_thread, threads, n);
+            cancel_point(current_thread);
+        }
+    }
+
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+}
+
+int dccthread_wait_any(dccthread_t **threads, int n, int *which)
+{
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+
+    dccthread_t *current_thread = dccthread_self();
+    int index = -1, candidates = 0;
+
+    cancel_point(current_thread);
+
+    for (int i = 0; i < n && index == -1; i++)
+    {
+        if (threads[i] == NULL || threads[i] == current_thread)
+            continue;
+        candidates++;
+        if (threads[i]->exited)
+            index = i;
+    }
+
+    if (index == -1 && candidates > 0)
+    {
+        for (int i = 0; i < n; i++)
+            if (threads[i] != NULL && threads[i] != current_thread)
+                join_register(current_thread, threads[i]);
+
+        // a primeira thread a terminar acorda a thread corrente
+        current_thread->join_remaining = 1;
+        dccthread_switch(current_thread);
+
+        join_unregister(current_thread, threads, n);
+        cancel_point(current_thread);
+        for (int i = 0; i < n && index == -1; i++)
+            if (threads[i] != NULL && threads[i] != current_thread && threads[i]->exited)
+                index = i;
+    }
+
+    if (index != -1)
+    {
+        threads[index]->has_waited = 1;
+        if (which != NULL)
+            *which = index;
+    }
+
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+
+    return index == -1 ? -1 : 0;
+}
+
+void dccthread_wait(dccthread_t *tid)
+{
+    dccthread_wait_all(&tid, 1);
+}
+
+void dccthread_sleep(struct timespec ts)
+{
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    cancel_point(main_thread);
+
+#ifdef DCCTHREAD_SIM
+    // na simulação o prazo é marcado no relógio virtual e o gerente acorda a thread
+    main_thread->wake_at = sim_now + ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    main_thread->sleeping = 1;
+    dlist_push_right(waiting, main_thread);
+    dccthread_switch(main_thread);
+    main_thread->sleeping = 0;
+    cancel_point(main_thread);
+
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+    return;
+#endif
+
+    // o temporizador fica na thread para que dccthread_cancel possa removê-lo
+    // a thread entra em waiting antes de o temporizador existir, para que o
+    // gerente a encontre mesmo que o sinal chegue antes da troca de contexto
+    dccthread_t *current_thread = main_thread;
+    dlist_push_right(waiting, current_thread);
+    timer_sleep_init(current_thread, &ts);
+    dccthread_switch(current_thread);
+
+    if (current_thread->sleeping)
+    {
+        timer_delete(current_thread->sleep_timer);
+        current_thread->sleeping = 0;
+    }
+    cancel_point(current_thread);
+
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+}
+
+dccthread_t *dccthread_self(void)
+{
+    return main_thread;
+}
+
+const char *dccthread_name(dccthread_t *tid)
+{
+    return tid->name;
+}
+
+struct timespec dccthread_cputime(dccthread_t *tid)
+{
+    struct timespec ts = {0, 0};
+    if (tid == NULL)
+        return ts;
+
+    long long ns = (long long)(tid->cpu_ticks / cpu_ticks_per_ns());
+    ts.tv_sec = ns / 1000000000LL;
+    ts.tv_nsec = ns % 1000000000LL;
+    return ts;
+}
+
+int dccthread_set_cpu_limit(dccthread_t *tid, struct timespec limit, int action)
+{
+    if (tid == NULL || tid->exited)
+        return -1;
+
+    long long ns = limit.tv_sec * 1000000000LL + limit.tv_nsec;
+    unsigned long long ticks = ns > 0 ? (unsigned long long)(ns * cpu_ticks_per_ns()) : 0;
+
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    tid->cpu_limit = ticks;
+    tid->cpu_limit_action = action;
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+    return 0;
+}
+
+int dccthread_cancel(dccthread_t *tid)
+{
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+
+    if (tid == NULL || tid->exited)
+    {
+        sigprocmask(SIG_UNBLOCK, &mask, NULL);
+        return -1;
+    }
+
+    cancel_request(tid);
+
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+    return 0;
+}
+
+void dccthread_testcancel(void)
+{
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    cancel_point(main_thread);
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+}
+
+void dccthread_cleanup_push(void (*routine)(void *), void *arg)
+{
+    dccthread_cleanup *handler = (dccthread_cleanup *)malloc(sizeof(dccthread_cleanup));
+    if (handler == NULL)
+        return;
+    handler->routine = routine;
+    handler->arg = arg;
+
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    handler->next = main_thread->cleanup;
+    main_thread->cleanup = handler;
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+}
+
+void dccthread_cleanup_pop(int execute)
+{
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    dccthread_cleanup *handler = main_thread->cleanup;
+    if (handler != NULL)
+        main_thread->cleanup = handler->next;
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+
+    if (handler == NULL)
+        return;
+    if (execute)
+        handler->routine(handler->arg);
+    free(handler);
+}
+
+// função das trabalhadoras do executor: retira tarefas da fila e as executa até
+// que o executor seja destruído e a fila esvazie
+void dcc_pool_worker(int _)
+{
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    dcc_pool_t *pool = main_thread->pool;
+
+    for (;;)
+    {
+        while (pool->count == 0 && !pool->stopping)
+            dccthread_block(pool->idle);
+        if (pool->count == 0)
+            break;
+
+        dcc_job job = pool->jobs[pool->head];
+        pool->head = (pool->head + 1) % pool->capacity;
+        pool->count--;
+        dccthread_unblock(pool->submitters);
+
+        sigprocmask(SIG_UNBLOCK, &mask, NULL);
+        long long start = dccthread_now_ns();
+        job.func(job.param);
+        long long end = dccthread_now_ns();
+        sigprocmask(SIG_BLOCK, &mask, NULL);
+
+        pool->stats.wait_ns += start - job.enqueued_at;
+        pool->stats.service_ns += end - start;
+        pool->stats.completed++;
+    }
+
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+}
+
+dcc_pool_t *dcc_pool_create(const char *name, int nworkers, int capacity)
+{
+    if (nworkers <= 0 || capacity <= 0)
+        return NULL;
+
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+
+    dcc_pool_t *pool = (dcc_pool_t *)calloc(1, sizeof(dcc_pool_t));
+    pool->jobs = (dcc_job *)malloc(capacity * sizeof(dcc_job));
+    pool->capacity = capacity;
+    pool->nworkers = nworkers;
+    pool->workers = (dccthread_t **)malloc(nworkers * sizeof(dccthread_t *));
+    pool->idle = dlist_create();
+    pool->submitters = dlist_create();
+
+    for (int i = 0; i < nworkers; i++)
+    {
+        char worker_name[DCCTHREAD_MAX_NAME_SIZE];
+        snprintf(worker_name, sizeof(worker_name), "%.200s-%d", name, i);
+        pool->workers[i] = thread_new(worker_name, dcc_pool_worker, i);
+        pool->workers[i]->pool = pool;
+    }
+
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+
+    return pool;
+}
+
+int dcc_pool_submit(dcc_pool_t *pool, void (*func)(int), int param, int mode)
+{
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+
+    while (pool->count == pool->capacity && !pool->stopping && mode == DCC_POOL_BLOCK)
+        dccthread_block(pool->submitters);
+
+    if (pool->count == pool->capacity || pool->stopping)
+    {
+        pool->stats.rejected++;
+        sigprocmask(SIG_UNBLOCK, &mask, NULL);
+        return -1;
+    }
+
+    dcc_job *job = &pool->jobs[(pool->head + pool->count) % pool->capacity];
+    job->func = func;
+    job->param = param;
+    job->enqueued_at = dccthread_now_ns();
+    pool->count++;
+    pool->stats.submitted++;
+    if (pool->count > pool->stats.max_queue_depth)
+        pool->stats.max_queue_depth = pool->count;
+    dccthread_unblock(pool->idle);
+
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+
+    return 0;
+}
+
+void dcc_pool_stats(dcc_pool_t *pool, struct dcc_pool_stats *stats)
+{
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+
+    *stats = pool->stats;
+    stats->queue_depth = pool->count;
+
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+}
+
+void dcc_pool_destroy(dcc_pool_t *pool)
+{
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+
+    pool->stopping = 1;
+    while (dccthread_unblock(pool->idle))
+        ;
+    while (dccthread_unblock(pool->submitters))
+        ;
+
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+
+    dccthread_wait_all(pool->workers, pool->nworkers);
+
+    dlist_destroy(pool->idle, NULL);
+    dlist_destroy(pool->submitters, NULL);
+    free(pool->workers);
+    free(pool->jobs);
+    free(pool);
+}
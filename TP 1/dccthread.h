@@ -1,13 +1,19 @@
 #ifndef __DCCTHREAD_HEADER__
 #define __DCCTHREAD_HEADER__
 
+#include <stdio.h>
 #include <time.h>
 
 typedef struct dccthread dccthread_t;
+typedef struct dcc_gen dcc_gen_t;
+typedef struct dcc_pool dcc_pool_t;
 
 #define DCCTHREAD_MAX_NAME_SIZE 256
 #define THREAD_STACK_SIZE (1<<16)
 
+#define DCCTHREAD_STACK_DEDICATED 0
+#define DCCTHREAD_STACK_COPY 1
+
 /* `dccthread_init` initializes any state necessary for the
  * threadling library and starts running `func`.  this function
  * never returns. */
@@ -20,10 +26,32 @@ void dccthread_init(void (*func)(int), int param) __attribute__((noreturn));
 dccthread_t * dccthread_create(const char *name,
 		void (*func)(int ), int param);
 
+struct dccthread_spec {
+	const char *name;
+	void (*func)(int);
+	int param;
+};
+
+/* `dccthread_create_batch` creates `n` threads at once, as if by
+ * calling `dccthread_create` on each entry of `specs` in order, and
+ * stores their handles in `out`.  descriptors and stacks come from
+ * one allocation each, and the threads enter the ready list in a
+ * single step.  returns `n` on success and -1 (creating no thread)
+ * on failure. */
+int dccthread_create_batch(const struct dccthread_spec *specs, int n,
+		dccthread_t **out);
+
 /* `dccthread_yield` will yield the CPU (from the current thread to
  * another). */
 void dccthread_yield(void);
 
+/* `dccthread_yield_to` yields the CPU straight to thread `tid`,
+ * which runs next for the rest of the caller's time slice; the
+ * caller goes to the end of the ready list.  returns 0 on success.
+ * if `tid` is not ready to run, it behaves like `dccthread_yield`
+ * and returns -1. */
+int dccthread_yield_to(dccthread_t *tid);
+
 /* `dccthread_exit` terminates the current thread, freeing all
  * associated resources. */
 void dccthread_exit(void);
@@ -32,6 +60,17 @@ void dccthread_exit(void);
  * terminates. */
 void dccthread_wait(dccthread_t *tid);
 
+/* `dccthread_wait_all` blocks the current thread until every
+ * thread in `threads` (an array of `n` handles) terminates.  the
+ * caller leaves the CPU once and is woken by the last thread to
+ * exit.  `NULL` entries are ignored. */
+void dccthread_wait_all(dccthread_t **threads, int n);
+
+/* `dccthread_wait_any` blocks the current thread until at least one
+ * thread in `threads` terminates and stores its index in `which`.
+ * returns 0 on success and -1 if `threads` has no valid entry. */
+int dccthread_wait_any(dccthread_t **threads, int n, int *which);
+
 /* `dccthread_sleep` stops the current thread for the time period
  * specified in `ts`. */
 void dccthread_sleep(struct timespec ts);
@@ -44,4 +83,199 @@ dccthread_t * dccthread_self(void);
  * by the library. */
 const char * dccthread_name(dccthread_t *tid);
 
+/* `dccthread_cputime` returns the CPU time thread `tid` has used,
+ * measured with the time-stamp counter when the scheduler switches
+ * the thread in and out.  the current thread's ongoing time slice
+ * is not included. */
+struct timespec dccthread_cputime(dccthread_t *tid);
+
+#define DCCTHREAD_LIMIT_DEMOTE 0
+#define DCCTHREAD_LIMIT_CANCEL 1
+
+/* `dccthread_set_cpu_limit` sets a budget of CPU time for thread
+ * `tid`, counted from its creation.  when the thread leaves the CPU
+ * past the budget, `DCCTHREAD_LIMIT_DEMOTE` makes it run only when
+ * no other thread is ready (and takes it out of the EDF class), and
+ * `DCCTHREAD_LIMIT_CANCEL` calls `dccthread_cancel` on it.  a zero
+ * `limit` removes the budget.  returns 0 on success and -1 if `tid`
+ * has already exited. */
+int dccthread_set_cpu_limit(dccthread_t *tid, struct timespec limit, int action);
+
+/* `dccthread_cancel` requests the termination of thread `tid`.
+ * cancellation is deferred: `tid` terminates the next time it is at
+ * a cancellation point (`dccthread_yield`, `dccthread_sleep`, the
+ * wait functions, a blocking `dcc_pool_submit` or
+ * `dccthread_testcancel`).  a thread already stopped at one of them
+ * is made ready at once; a sleeping thread's timer is removed.
+ * before terminating, the thread runs its cleanup handlers.  returns
+ * 0 on success and -1 if `tid` has already exited. */
+int dccthread_cancel(dccthread_t *tid);
+
+/* `dccthread_testcancel` is a cancellation point with no other
+ * effect, for threads that loop without calling the library (e.g.,
+ * around nonblocking I/O). */
+void dccthread_testcancel(void);
+
+/* `dccthread_cleanup_push` pushes `routine(arg)` on the current
+ * thread's cleanup stack; handlers run in reverse order if the
+ * thread is cancelled.  `dccthread_cleanup_pop` removes the top
+ * handler and runs it if `execute` is nonzero. */
+void dccthread_cleanup_push(void (*routine)(void *), void *arg);
+void dccthread_cleanup_pop(int execute);
+
+/* `dccthread_set_timeslice` changes the preemption quantum to `ts`
+ * (10 ms by default).  may be called before or after
+ * `dccthread_init`.  the default can also be given in nanoseconds
+ * through the `DCCTHREAD_TIMESLICE_NS` environment variable. */
+void dccthread_set_timeslice(struct timespec ts);
+
+/* `dccthread_set_clock` selects the clock that drives preemption
+ * (`CLOCK_PROCESS_CPUTIME_ID` by default).  returns 0 on success
+ * and -1 if a timer cannot be created on `clock`, in which case the
+ * previous clock is kept.  the `DCCTHREAD_CLOCK` environment
+ * variable accepts `process`, `thread`, `monotonic` or `realtime`. */
+int dccthread_set_clock(clockid_t clock);
+
+/* `dccthread_set_adaptive` turns the adaptive time slice on or off
+ * (also controlled by `DCCTHREAD_ADAPTIVE=1`).  in adaptive mode
+ * the preemption timer is disarmed while a single thread is
+ * runnable, and the quantum shrinks when many newly created threads
+ * are waiting for their first turn on the CPU. */
+void dccthread_set_adaptive(int enabled);
+
+/* `dccthread_set_stack_mode` selects how thread stacks are managed
+ * and must be called before `dccthread_init` (returns -1
+ * otherwise).  with `DCCTHREAD_STACK_DEDICATED` (the default) each
+ * thread owns a `THREAD_STACK_SIZE` stack.  with
+ * `DCCTHREAD_STACK_COPY` (or `DCCTHREAD_STACK_COPY=1` in the
+ * environment) all threads run on one shared stack, and the live
+ * part of a thread's stack is copied to a right-sized buffer when
+ * another thread needs the shared stack.  in this mode a thread
+ * must not hand out pointers to its stack variables to other
+ * threads. */
+int dccthread_set_stack_mode(int mode);
+
+struct dccthread_deadline_stats {
+	long jobs;                  /* jobs completed (a yield ends a job) */
+	long misses;                /* jobs completed after their deadline */
+	long overruns;              /* times the budget ran out before a yield */
+	long long max_lateness_ns;  /* worst completion past the deadline */
+};
+
+/* `dccthread_set_deadline` moves the current thread to the
+ * earliest-deadline-first class.  every `period` the thread gets a
+ * new job that may use up to `runtime`, measured on the preemption
+ * clock (see `dccthread_set_clock`), and must finish within
+ * `deadline` (`period` if zero) of the start of the period; calling
+ * `dccthread_yield` ends the job and the thread sleeps until the
+ * next period.  a runnable EDF thread always runs before ordinary
+ * threads, and the preemption timer stops it when the budget runs
+ * out.  returns -1 and changes nothing if the parameters are invalid
+ * or if the sum of runtime/min(deadline, period) over all EDF
+ * threads would exceed 1.  a zero `period` returns the thread to
+ * the ordinary class.  not available in the simulation build. */
+int dccthread_set_deadline(struct timespec period, struct timespec runtime,
+		struct timespec deadline);
+
+/* `dccthread_deadline_stats` copies the deadline statistics of
+ * thread `tid` into `stats`.  returns 0 on success and -1 on
+ * failure. */
+int dccthread_deadline_stats(dccthread_t *tid, struct dccthread_deadline_stats *stats);
+
+#define DCCTHREAD_CPU_CURRENT (-1)
+
+/* `dccthread_set_cpu` pins the kernel thread that runs every
+ * dccthread to `cpu`, or to the CPU it is running on when `cpu` is
+ * `DCCTHREAD_CPU_CURRENT`.  the CPU must be listed in
+ * `/sys/devices/system/cpu/online`.  returns the chosen CPU, or -1
+ * on failure.  `dccthread_init` applies `DCCTHREAD_CPU=<n>` or
+ * `DCCTHREAD_CPU=current` from the environment. */
+int dccthread_set_cpu(int cpu);
+
+/* `dcc_gen_create` creates a generator that will run `func` with
+ * parameter `param` on its own stack.  the generator does not run
+ * until a thread calls `dcc_gen_next`.  returns `NULL` on failure. */
+dcc_gen_t * dcc_gen_create(void (*func)(int), int param);
+
+/* `dcc_gen_next` resumes `gen` until it calls `dcc_gen_yield`, then
+ * stores the yielded value in `value` and returns 1.  returns 0 once
+ * the generator's function has returned.  control goes straight to
+ * the generator and back, without passing through the ready list;
+ * the generator runs on behalf of the calling thread and is
+ * preempted with it. */
+int dcc_gen_next(dcc_gen_t *gen, void **value);
+
+/* `dcc_gen_yield` is called from inside a generator to hand `value`
+ * to the thread blocked in `dcc_gen_next`.  it returns when the
+ * generator is resumed again.  generators may consume other
+ * generators. */
+void dcc_gen_yield(void *value);
+
+/* `dcc_gen_destroy` frees `gen`, which must not be running. */
+void dcc_gen_destroy(dcc_gen_t *gen);
+
+#define DCC_POOL_BLOCK 0
+#define DCC_POOL_REJECT 1
+
+struct dcc_pool_stats {
+	int queue_depth;        /* tasks currently queued */
+	int max_queue_depth;    /* highest queue depth seen */
+	long submitted;         /* tasks accepted */
+	long rejected;          /* tasks refused (queue full or pool stopping) */
+	long completed;         /* tasks finished */
+	long long wait_ns;      /* total time tasks spent queued */
+	long long service_ns;   /* total time tasks spent running */
+};
+
+/* `dcc_pool_create` creates an executor with `nworkers` worker
+ * threads (named `name-0`, `name-1`, ...) and a queue that holds at
+ * most `capacity` tasks.  returns `NULL` on failure. */
+dcc_pool_t * dcc_pool_create(const char *name, int nworkers, int capacity);
+
+/* `dcc_pool_submit` queues `func(param)` to run on one of the
+ * workers.  if the queue is full, `DCC_POOL_BLOCK` blocks the caller
+ * until there is room and `DCC_POOL_REJECT` fails immediately.
+ * returns 0 when the task was queued and -1 when it was rejected. */
+int dcc_pool_submit(dcc_pool_t *pool, void (*func)(int), int param, int mode);
+
+/* `dcc_pool_stats` copies the executor's metrics into `stats`. */
+void dcc_pool_stats(dcc_pool_t *pool, struct dcc_pool_stats *stats);
+
+/* `dcc_pool_destroy` rejects new tasks, waits until the queued ones
+ * finish and the workers exit, and frees `pool`. */
+void dcc_pool_destroy(dcc_pool_t *pool);
+
+/* `dccthread_prof_start` starts a sampling profiler driven by
+ * `SIGPROF` at `hz` samples per second of process CPU time.  each
+ * sample records the running thread (or the scheduler itself) and
+ * its call stack in a preallocated buffer.  returns 0 on success
+ * and -1 on failure.  `dccthread_prof_stop` stops sampling. */
+int dccthread_prof_start(int hz);
+void dccthread_prof_stop(void);
+
+/* `dccthread_prof_dump` writes the samples to `out` in the collapsed
+ * stack format read by flamegraph.pl, one line per distinct stack
+ * with the thread name as the root frame.  function names need the
+ * program to be linked with `-rdynamic`; otherwise addresses are
+ * printed.  returns the number of samples dropped because the
+ * buffer was full or there was no memory to format them, or -1 if
+ * nothing could be written for lack of memory. */
+int dccthread_prof_dump(FILE *out);
+
+#ifdef DCCTHREAD_SIM
+/* when the library is built with `-DDCCTHREAD_SIM`, time is
+ * simulated: `dccthread_sleep` uses a virtual clock that jumps to
+ * the next sleeper's deadline whenever every thread is blocked,
+ * each scheduling decision advances it by 1 us, and there is no
+ * timer-driven preemption.  scheduling is FIFO unless a nonzero
+ * seed is given with `dccthread_sim_seed` (or `DCCTHREAD_SIM_SEED`)
+ * before `dccthread_init`, in which case the next thread is drawn
+ * from the ready list with a generator seeded by it.  the same
+ * seed always yields the same interleaving. */
+void dccthread_sim_seed(unsigned seed);
+
+/* `dccthread_sim_time` returns the current virtual time. */
+struct timespec dccthread_sim_time(void);
+#endif
+
 #endif
@@ -1,14 +1,46 @@
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include "dlist.h"
 
+#define DLIST_INITIAL_CAPACITY 16
+
+/* slot in =dl->items of the element at position =pos (0 = leftmost). */
+#define DLIST_SLOT(dl, pos) (((dl)->first + (pos)) & ((dl)->capacity - 1))
+
+/* makes room for at least =extra more elements, unwrapping the ring into a
+ * buffer twice as large (or more) when it is full. */
+static void dlist_reserve(struct dlist *dl, int extra) /* {{{ */
+{
+	int capacity = dl->capacity;
+	void **items;
+	int right;
+
+	if(dl->count + extra <= capacity) return;
+	while(capacity < dl->count + extra) capacity *= 2;
+
+	items = malloc(capacity * sizeof(void *));
+	assert(items);
+	right = dl->capacity - dl->first;
+	if(right > dl->count) right = dl->count;
+	memcpy(items, dl->items + dl->first, right * sizeof(void *));
+	memcpy(items + right, dl->items, (dl->count - right) * sizeof(void *));
+
+	free(dl->items);
+	dl->items = items;
+	dl->capacity = capacity;
+	dl->first = 0;
+} /* }}} */
+
 struct dlist *dlist_create(void) /* {{{ */
 {
 	struct dlist *dl = malloc(sizeof(struct dlist));
 	assert(dl);
-	dl->head = NULL;
-	dl->tail = NULL;
+	dl->items = malloc(DLIST_INITIAL_CAPACITY * sizeof(void *));
+	assert(dl->items);
+	dl->capacity = DLIST_INITIAL_CAPACITY;
+	dl->first = 0;
 	dl->count = 0;
 	return dl;
 } /* }}} */
@@ -19,24 +51,18 @@ void dlist_destroy(struct dlist *dl, dlist_data_func cb) /* {{{ */
 		void *data = dlist_pop_left(dl);
 		if(cb) cb(data);
 	}
+	free(dl->items);
 	free(dl);
 } /* }}} */
 
 void *dlist_pop_left(struct dlist *dl) /* {{{ */
 {
 	void *data;
-	struct dnode *node;
 
 	if(dlist_empty(dl)) return NULL;
 
-	node = dl->head;
-
-	dl->head = node->next;
-	if(dl->head == NULL) dl->tail = NULL;
-	if(node->next) node->next->prev = NULL;
-
-	data = node->data;
-	free(node);
+	data = dl->items[dl->first];
+	dl->first = DLIST_SLOT(dl, 1);
 
 	dl->count--;
 	assert(dl->count >= 0);
@@ -45,57 +71,64 @@ void *dlist_pop_left(struct dlist *dl) /* {{{ */
 
 void *dlist_pop_right(struct dlist *dl) /* {{{ */
 {
-	void *data;
-	struct dnode *node;
-
 	if(dlist_empty(dl)) return NULL;
 
-	node = dl->tail;
-
-	dl->tail = node->prev;
-	if(dl->tail == NULL) dl->head = NULL;
-	if(node->prev) node->prev->next = NULL;
-
-	data = node->data;
-	free(node);
-
 	dl->count--;
 	assert(dl->count >= 0);
+	return dl->items[DLIST_SLOT(dl, dl->count)];
+} /* }}} */
+
+void *dlist_push_left(struct dlist *dl, void *data) /* {{{ */
+{
+	dlist_reserve(dl, 1);
+	dl->first = DLIST_SLOT(dl, dl->capacity - 1);
+	dl->items[dl->first] = data;
+	dl->count++;
 	return data;
 } /* }}} */
 
 void *dlist_push_right(struct dlist *dl, void *data) /* {{{ */
 {
-	struct dnode *node = malloc(sizeof(struct dnode));
-	assert(node);
+	dlist_reserve(dl, 1);
+	dl->items[DLIST_SLOT(dl, dl->count)] = data;
+	dl->count++;
+	return data;
+} /* }}} */
 
-	node->data = data;
-	node->prev = dl->tail;
-	node->next = NULL;
+void dlist_push_right_array(struct dlist *dl, void **data, int n) /* {{{ */
+{
+	int slot, right;
 
-	if(dl->tail) dl->tail->next = node;
-	dl->tail = node;
+	if(n <= 0) return;
 
-	if(dl->head == NULL) dl->head = node;
+	dlist_reserve(dl, n);
+	slot = DLIST_SLOT(dl, dl->count);
+	right = dl->capacity - slot;
+	if(right > n) right = n;
+	memcpy(dl->items + slot, data, right * sizeof(void *));
+	memcpy(dl->items, data + right, (n - right) * sizeof(void *));
 
-	dl->count++;
-	return data;
+	dl->count += n;
 } /* }}} */
 
 void *dlist_find_remove(struct dlist *dl, void *data, /* {{{ */
 		dlist_cmp_func cmp, void *user_data)
 {
-	struct dnode *curr;
-	for(curr = dl->head; curr; curr = curr->next) {
-		if(!curr->data) continue;
-		if(cmp(curr->data, data, user_data)) continue;
-		void *ptr = curr->data;
-		if(dl->head == curr) dl->head = curr->next;
-		if(dl->tail == curr) dl->tail = curr->prev;
-		if(curr->prev) curr->prev->next = curr->next;
-		if(curr->next) curr->next->prev = curr->prev;
+	int pos, i;
+	for(pos = 0; pos < dl->count; pos++) {
+		void *ptr = dl->items[DLIST_SLOT(dl, pos)];
+		if(!ptr) continue;
+		if(cmp(ptr, data, user_data)) continue;
+		/* closes the gap by moving the shorter side of the list */
+		if(pos < dl->count / 2) {
+			for(i = pos; i > 0; i--)
+				dl->items[DLIST_SLOT(dl, i)] = dl->items[DLIST_SLOT(dl, i - 1)];
+			dl->first = DLIST_SLOT(dl, 1);
+		} else {
+			for(i = pos; i < dl->count - 1; i++)
+				dl->items[DLIST_SLOT(dl, i)] = dl->items[DLIST_SLOT(dl, i + 1)];
+		}
 		dl->count--;
-		free(curr);
 		return ptr;
 	}
 	return NULL;
@@ -103,41 +136,20 @@ void *dlist_find_remove(struct dlist *dl, void *data, /* {{{ */
 
 int dlist_empty(struct dlist *dl) /* {{{ */
 {
-	if(dl->head == NULL) {
-		assert(dl->tail == NULL);
-		assert(dl->count == 0);
-		return 1;
-	} else {
-		assert(dl->tail != NULL);
-		assert(dl->count > 0);
-		return 0;
-	}
+	assert(dl->count >= 0);
+	return dl->count == 0;
 } /* }}} */
 
 void * dlist_get_index(const struct dlist *dl, int idx) /* {{{ */
 {
-	struct dnode *curr;
-	if(idx >= 0) {
-		curr = dl->head;
-		while(curr && idx--) curr = curr->next;
-	} else {
-		curr = dl->tail;
-		while(curr && ++idx) curr = curr->prev;
-	}
-	if(!curr) return NULL;
-	return curr->data;
+	if(idx < 0) idx += dl->count;
+	if(idx < 0 || idx >= dl->count) return NULL;
+	return dl->items[DLIST_SLOT(dl, idx)];
 } /* }}} */
 
 void dlist_set_index(struct dlist *dl, int idx, void *data) /* {{{ */
 {
-	struct dnode *curr;
-	if(idx >= 0) {
-		curr = dl->head;
-		while(curr && idx--) curr = curr->next;
-	} else {
-		curr = dl->tail;
-		while(curr && ++idx) curr = curr->prev;
-	}
-	if(!curr) return;
-	curr->data = data;
+	if(idx < 0) idx += dl->count;
+	if(idx < 0 || idx >= dl->count) return;
+	dl->items[DLIST_SLOT(dl, idx)] = data;
 } /* }}} */
@@ -1,18 +1,16 @@
 #ifndef __DLIST_H__
 #define __DLIST_H__
 
+/* a double-ended queue stored in a growable ring buffer.  pushing and
+ * popping at either end and indexing are O(1); elements are contiguous
+ * (modulo one wrap-around), so walking the list is cache-friendly. */
 struct dlist {
-	struct dnode *head;
-	struct dnode *tail;
+	void **items;   /* ring buffer with =capacity slots (a power of two) */
+	int capacity;
+	int first;      /* slot of the leftmost element */
 	int count;
 };
 
-struct dnode {
-	struct dnode *prev;
-	struct dnode *next;
-	void *data;
-};
-
 typedef void (*dlist_data_func)(void *data);
 typedef int (*dlist_cmp_func)(const void *e1, const void *e2, void *userdata); 
 
@@ -21,7 +19,10 @@ void dlist_destroy(struct dlist *dl, dlist_data_func);
 
 void *dlist_pop_left(struct dlist *dl);
 void *dlist_pop_right(struct dlist *dl);
+void *dlist_push_left(struct dlist *dl, void *data);
 void *dlist_push_right(struct dlist *dl, void *data);
+/* appends the =n pointers in =data to =dl, in order, in a single splice. */
+void dlist_push_right_array(struct dlist *dl, void **data, int n);
 
 /* this function calls =cmp to compare =data and each value in =dl.  if a
  * match is found, it is removed from the list and its pointer is returned.
@@ -4,7 +4,7 @@ set -eu
 # DCC605: Userspace threading library programming assignment
 # Autograding script
 
-total=19
+total=32
 ecnt=0
 
 if ! tests/test0.sh ; then ecnt=$(( $ecnt + 1 )) ; fi
@@ -40,6 +40,22 @@ if ! tests/test11.sh ; then ecnt=$(( $ecnt + 1 )) ; fi
 if ! tests/test12.sh ; then ecnt=$(( $ecnt + 1 )) ; fi
 if ! tests/test12.sh ; then ecnt=$(( $ecnt + 1 )) ; fi
 
+if ! tests/test13.sh ; then ecnt=$(( $ecnt + 1 )) ; fi
+
+if ! tests/test14.sh ; then ecnt=$(( $ecnt + 1 )) ; fi
+
+if ! tests/test15.sh ; then ecnt=$(( $ecnt + 1 )) ; fi
+if ! tests/test16.sh ; then ecnt=$(( $ecnt + 1 )) ; fi
+if ! tests/test17.sh ; then ecnt=$(( $ecnt + 1 )) ; fi
+if ! tests/test18.sh ; then ecnt=$(( $ecnt + 1 )) ; fi
+if ! tests/test19.sh ; then ecnt=$(( $ecnt + 1 )) ; fi
+if ! tests/test20.sh ; then ecnt=$(( $ecnt + 1 )) ; fi
+if ! tests/test21.sh ; then ecnt=$(( $ecnt + 1 )) ; fi
+if ! tests/test22.sh ; then ecnt=$(( $ecnt + 1 )) ; fi
+if ! tests/test23.sh ; then ecnt=$(( $ecnt + 1 )) ; fi
+if ! tests/test24.sh ; then ecnt=$(( $ecnt + 1 )) ; fi
+if ! tests/test25.sh ; then ecnt=$(( $ecnt + 1 )) ; fi
+
 
 echo "your code passes $(( $total - $ecnt )) of $total tests"
 rm -f dlist.o dccthread.o
@@ -0,0 +1,55 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <string.h>
+#include "dccthread.h"
+
+const char *text = "the quick brown fox jumps over the lazy dog";
+dcc_gen_t *words;
+
+void tokenize(int dummy) {
+	static char word[16][16];
+	int n = 0;
+	const char *p = text;
+	while(*p) {
+		int len = strcspn(p, " ");
+		sprintf(word[n], "%.*s", len, p);
+		dcc_gen_yield(word[n]);
+		n = (n + 1) % 16;
+		p += len;
+		if(*p) p++;
+	}
+}
+
+void upcase(int dummy) {
+	void *value;
+	while(dcc_gen_next(words, &value)) {
+		char *w = value;
+		for(; *w; w++) *w = toupper(*w);
+		dcc_gen_yield(value);
+	}
+}
+
+void other(int dummy) {
+	printf("other thread running\n");
+}
+
+void test(int dummy) {
+	dccthread_create("other", other, 0);
+	words = dcc_gen_create(tokenize, 0);
+	dcc_gen_t *upper = dcc_gen_create(upcase, 0);
+	void *value;
+	while(dcc_gen_next(upper, &value)) {
+		printf("%s %s\n", dccthread_name(dccthread_self()), (char *)value);
+	}
+	printf("generator done %d\n", dcc_gen_next(upper, &value));
+	dcc_gen_destroy(upper);
+	dcc_gen_destroy(words);
+	dccthread_yield();
+	dccthread_exit();
+}
+
+int main(int argc, char **argv)
+{
+	dccthread_init(test, 0);
+}
@@ -0,0 +1,34 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "dccthread.h"
+
+void job(int id) {
+	printf("job %d on %s\n", id, dccthread_name(dccthread_self()));
+	dccthread_yield();
+}
+
+void test(int dummy) {
+	int i;
+	struct dcc_pool_stats stats;
+	dcc_pool_t *pool = dcc_pool_create("worker", 2, 2);
+	for(i = 0; i < 4; i++) {
+		int r = dcc_pool_submit(pool, job, i, DCC_POOL_REJECT);
+		printf("submit %d returned %d\n", i, r);
+	}
+	for(i = 4; i < 8; i++) {
+		dcc_pool_submit(pool, job, i, DCC_POOL_BLOCK);
+		dcc_pool_stats(pool, &stats);
+		printf("submitted %d, queue depth %d\n", i, stats.queue_depth);
+	}
+	dcc_pool_stats(pool, &stats);
+	printf("submitted %ld rejected %ld max depth %d\n", stats.submitted,
+			stats.rejected, stats.max_queue_depth);
+	dcc_pool_destroy(pool);
+	printf("done\n");
+	dccthread_exit();
+}
+
+int main(int argc, char **argv)
+{
+	dccthread_init(test, 0);
+}
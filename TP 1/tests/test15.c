@@ -0,0 +1,33 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "dccthread.h"
+
+void tyield(int cnt) {
+	int i;
+	for(i = 0; i < cnt; i++) {
+		dccthread_yield();
+	}
+	printf("%s exiting\n", dccthread_name(dccthread_self()));
+}
+
+void test(int cnt) {
+	dccthread_t *threads[4];
+	int i, which = -1;
+	for(i = 0; i < cnt; i++) {
+		char name[16];
+		sprintf(name, "t%d", i);
+		threads[i] = dccthread_create(name, tyield, 2*(cnt-i));
+	}
+	dccthread_wait_any(threads, cnt, &which);
+	printf("first to finish was %s\n", dccthread_name(threads[which]));
+	dccthread_wait_all(threads, cnt);
+	printf("all finished\n");
+	dccthread_wait_any(threads, cnt, &which);
+	printf("wait_any on finished threads returned %d\n", which);
+	dccthread_exit();
+}
+
+int main(int argc, char **argv)
+{
+	dccthread_init(test, 4);
+}
@@ -0,0 +1,89 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <malloc.h>
+#include "dccthread.h"
+
+void cleanup(void *msg) {
+	printf("%s cleanup: %s\n", dccthread_name(dccthread_self()), (char *)msg);
+}
+
+void tsleep(int seconds) {
+	struct timespec ts;
+	ts.tv_sec = seconds;
+	ts.tv_nsec = 0;
+	dccthread_cleanup_push(cleanup, "outer");
+	dccthread_cleanup_push(cleanup, "inner");
+	dccthread_sleep(ts);
+	printf("sleeper should not wake up\n");
+}
+
+void tspin(int _) {
+	dccthread_cleanup_push(cleanup, "spin");
+	dccthread_cleanup_pop(0);
+	for(;;) {
+		dccthread_yield();
+	}
+}
+
+dccthread_t *spinner;
+
+void spin(int msec) {
+	struct timespec start, now;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	do {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	} while((now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000 < msec);
+}
+
+void tnap(int _) {
+	struct timespec ts = {0, 1000000};
+	dccthread_cleanup_push(cleanup, "nap");
+	dccthread_sleep(ts);
+	printf("napper should not return\n");
+}
+
+void twait(int _) {
+	spinner = dccthread_create("spinner", tspin, 0);
+	dccthread_cleanup_push(cleanup, "wait");
+	dccthread_wait(spinner);
+	printf("waiter should not return\n");
+}
+
+void test(int _) {
+	dccthread_t *threads[2];
+	threads[0] = dccthread_create("sleeper", tsleep, 10);
+	threads[1] = dccthread_create("waiter", twait, 0);
+	dccthread_yield();
+	dccthread_yield();
+
+	printf("cancel sleeper: %d\n", dccthread_cancel(threads[0]));
+	printf("cancel waiter: %d\n", dccthread_cancel(threads[1]));
+	dccthread_wait_all(threads, 2);
+	printf("sleeper and waiter done\n");
+	printf("cancel spinner: %d\n", dccthread_cancel(spinner));
+	dccthread_wait(spinner);
+	printf("spinner done\n");
+	printf("cancel sleeper again: %d\n", dccthread_cancel(threads[0]));
+
+	/* the napper's timer fires while this thread spins; the yield lets
+	 * the manager move it to the ready list before it runs again */
+	struct timespec slice = {1, 0};
+	dccthread_set_timeslice(slice);
+	threads[0] = dccthread_create("napper", tnap, 0);
+	dccthread_yield();
+	spin(20);
+	dccthread_yield();
+	printf("cancel woken napper: %d\n", dccthread_cancel(threads[0]));
+	dccthread_wait(threads[0]);
+	dccthread_yield();
+	printf("napper done\n");
+	dccthread_exit();
+}
+
+int main(int argc, char **argv)
+{
+	/* freed stacks are overwritten, so running a thread after its exit crashes */
+	mallopt(M_PERTURB, 0xa5);
+	dccthread_init(test, 0);
+}
@@ -0,0 +1,47 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "dccthread.h"
+
+struct timespec ms(int n) {
+	struct timespec ts;
+	ts.tv_sec = 0;
+	ts.tv_nsec = n * 1000000L;
+	return ts;
+}
+
+void tnormal(int _) {
+	printf("%s ran\n", dccthread_name(dccthread_self()));
+}
+
+void tperiodic(int jobs) {
+	int i;
+	printf("admit 50%%: %d\n", dccthread_set_deadline(ms(20), ms(10), ms(20)));
+	dccthread_create("normal", tnormal, 0);
+	for(i = 0; i < jobs; i++) {
+		printf("job %d\n", i);
+		dccthread_yield();
+	}
+	printf("leave: %d\n", dccthread_set_deadline(ms(0), ms(0), ms(0)));
+}
+
+void tadmit(int _) {
+	printf("admit 60%%: %d\n", dccthread_set_deadline(ms(10), ms(6), ms(10)));
+	printf("admit 40%%: %d\n", dccthread_set_deadline(ms(10), ms(4), ms(10)));
+	printf("runtime > deadline: %d\n", dccthread_set_deadline(ms(10), ms(4), ms(2)));
+}
+
+void test(int _) {
+	struct dccthread_deadline_stats stats;
+	dccthread_t *threads[2];
+	threads[0] = dccthread_create("periodic", tperiodic, 3);
+	threads[1] = dccthread_create("admit", tadmit, 0);
+	dccthread_wait_all(threads, 2);
+	dccthread_deadline_stats(threads[0], &stats);
+	printf("periodic completed %ld jobs\n", stats.jobs);
+	dccthread_exit();
+}
+
+int main(int argc, char **argv)
+{
+	dccthread_init(test, 0);
+}
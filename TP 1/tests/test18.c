@@ -0,0 +1,40 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "dccthread.h"
+
+int request = -1;
+dccthread_t *producer;
+
+void tother(int i) {
+	printf("other %d ran\n", i);
+}
+
+void tconsumer(int cnt) {
+	int i;
+	for(i = 0; i < cnt; i++) {
+		printf("consumer got %d\n", request);
+		dccthread_yield_to(producer);
+	}
+}
+
+void test(int cnt) {
+	int i;
+	dccthread_t *consumer;
+	producer = dccthread_self();
+	consumer = dccthread_create("consumer", tconsumer, cnt);
+	for(i = 0; i < 3; i++) {
+		dccthread_create("other", tother, i);
+	}
+	for(i = 0; i < cnt; i++) {
+		request = i;
+		printf("producer sent %d: %d\n", i, dccthread_yield_to(consumer));
+	}
+	dccthread_wait(consumer);
+	printf("yield to exited consumer: %d\n", dccthread_yield_to(consumer));
+	dccthread_exit();
+}
+
+int main(int argc, char **argv)
+{
+	dccthread_init(test, 3);
+}
@@ -0,0 +1,32 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "dccthread.h"
+
+void tprint(int i) {
+	dccthread_yield();
+	printf("%s: %d\n", dccthread_name(dccthread_self()), i);
+}
+
+void test(int cnt) {
+	struct dccthread_spec specs[8];
+	dccthread_t *threads[8];
+	char names[8][16];
+	int i;
+	for(i = 0; i < cnt; i++) {
+		sprintf(names[i], "batch%d", i);
+		specs[i].name = names[i];
+		specs[i].func = tprint;
+		specs[i].param = i * i;
+	}
+	printf("created %d\n", dccthread_create_batch(specs, cnt, threads));
+	dccthread_wait_all(threads, cnt);
+	printf("all done, last was %s\n", dccthread_name(threads[cnt-1]));
+	printf("created %d\n", dccthread_create_batch(specs, 2, threads));
+	dccthread_wait_all(threads, 2);
+	dccthread_exit();
+}
+
+int main(int argc, char **argv)
+{
+	dccthread_init(test, 8);
+}
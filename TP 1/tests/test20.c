@@ -0,0 +1,110 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "dccthread.h"
+
+long long cputime_ns(dccthread_t *tid) {
+	struct timespec ts = dccthread_cputime(tid);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void spin(int usec) {
+	struct timespec start, now;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	do {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	} while((now.tv_sec - start.tv_sec) * 1000000LL + (now.tv_nsec - start.tv_nsec) / 1000 < usec);
+}
+
+void cleanup(void *arg) {
+	printf("%s cancelled after at least 5 ms: %d\n", dccthread_name(dccthread_self()),
+			cputime_ns(dccthread_self()) >= 5000000);
+}
+
+void thog(int _) {
+	dccthread_cleanup_push(cleanup, NULL);
+	for(;;) {
+		spin(1000);
+		dccthread_yield();
+	}
+}
+
+long long now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void sleeper_cleanup(void *start) {
+	printf("sleeper cancelled before waking up: %d\n", now_ns() - *(long long *)start < 1000000000LL);
+}
+
+/* passes its limit and then sleeps: the manager must take it out of the
+ * waiting list and let it terminate right away */
+void tsleeper(int _) {
+	struct timespec ts = {10, 0};
+	long long start = now_ns();
+	dccthread_cleanup_push(sleeper_cleanup, &start);
+	spin(3000);
+	dccthread_sleep(ts);
+	printf("sleeper woke up\n");
+}
+
+/* an EDF thread demoted when its budget preemption takes it past the
+ * limit must still be queued somewhere */
+void trt(int _) {
+	struct timespec period = {0, 10000000}, runtime = {0, 3000000}, zero = {0, 0};
+	struct timespec limit = {0, 2000000};
+	int i;
+	printf("set_deadline=%d\n", dccthread_set_deadline(period, runtime, zero));
+	dccthread_set_cpu_limit(dccthread_self(), limit, DCCTHREAD_LIMIT_DEMOTE);
+	for(i = 0; i < 10; i++)
+		spin(1000);
+	printf("rt finished\n");
+}
+
+void tbatch(int _) {
+	while(cputime_ns(dccthread_self()) < 4000000) {
+		spin(1000);
+		dccthread_yield();
+	}
+	printf("batch done\n");
+}
+
+void tinteractive(int cnt) {
+	int i;
+	for(i = 0; i < cnt; i++) {
+		spin(100);
+		dccthread_yield();
+	}
+	printf("interactive done\n");
+}
+
+void test(int _) {
+	struct timespec limit = {0, 5000000};
+	dccthread_t *threads[3];
+	threads[0] = dccthread_create("hog", thog, 0);
+	dccthread_set_cpu_limit(threads[0], limit, DCCTHREAD_LIMIT_CANCEL);
+	dccthread_wait(threads[0]);
+
+	limit.tv_nsec = 2000000;
+	threads[0] = dccthread_create("sleeper", tsleeper, 0);
+	dccthread_set_cpu_limit(threads[0], limit, DCCTHREAD_LIMIT_CANCEL);
+	dccthread_wait(threads[0]);
+
+	limit.tv_nsec = 1000000;
+	threads[1] = dccthread_create("batch", tbatch, 0);
+	threads[2] = dccthread_create("interactive", tinteractive, 20);
+	dccthread_set_cpu_limit(threads[1], limit, DCCTHREAD_LIMIT_DEMOTE);
+	dccthread_wait_all(threads + 1, 2);
+
+	threads[0] = dccthread_create("rt", trt, 0);
+	dccthread_wait(threads[0]);
+	printf("main done\n");
+	dccthread_exit();
+}
+
+int main(int argc, char **argv)
+{
+	dccthread_init(test, 0);
+}
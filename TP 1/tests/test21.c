@@ -0,0 +1,50 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <signal.h>
+#include <time.h>
+#include "dccthread.h"
+
+volatile int started[2];
+
+int rtmin_blocked(void) {
+	sigset_t cur;
+	sigprocmask(SIG_BLOCK, NULL, &cur);
+	return sigismember(&cur, SIGRTMIN);
+}
+
+long long now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* never yields: the other thread only runs if the adaptive timer is
+ * armed while both are runnable */
+void tspin(int self) {
+	long long start = now_ns();
+	started[self] = 1;
+	while(!started[!self] && now_ns() - start < 2000000000LL);
+	printf("%s ran alongside the other: %d\n", dccthread_name(dccthread_self()),
+			started[!self]);
+}
+
+void test(int _) {
+	dccthread_t *threads[2];
+	dccthread_set_adaptive(0);
+	dccthread_set_adaptive(1);
+	printf("SIGRTMIN blocked in a thread: %d\n", rtmin_blocked());
+	threads[0] = dccthread_create("a", tspin, 0);
+	threads[1] = dccthread_create("b", tspin, 1);
+	dccthread_wait_all(threads, 2);
+	dccthread_exit();
+}
+
+int main(int argc, char **argv)
+{
+	struct timespec ts = {0, 2000000};
+	dccthread_set_adaptive(1);
+	dccthread_set_timeslice(ts);
+	dccthread_set_clock(CLOCK_MONOTONIC);
+	printf("SIGRTMIN blocked before init: %d\n", rtmin_blocked());
+	dccthread_init(test, 0);
+}
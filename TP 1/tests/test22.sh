@@ -0,0 +1,16 @@
+#!/bin/bash
+set -u
+
+# runs the other tests again with every thread on the shared stack
+# (DCCTHREAD_STACK_COPY=1); uses the objects built by test0
+
+export DCCTHREAD_STACK_COPY=1
+failed=0
+for i in $(seq 1 21) ; do
+    if ! tests/test$i.sh > /dev/null ; then
+        echo "[22] test$i fails in stack-copy mode"
+        failed=1
+    fi
+done
+
+exit $failed
@@ -0,0 +1,49 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "dccthread.h"
+
+/* built with -DDCCTHREAD_SIM: sleeps take no real time, and the run
+ * is the same every time for a given seed */
+
+long long sim_ms(void) {
+	struct timespec ts = dccthread_sim_time();
+	return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+void tsleep(int seconds) {
+	struct timespec ts = {seconds, 0};
+	dccthread_sleep(ts);
+	printf("%s woke up at %lld ms\n", dccthread_name(dccthread_self()), sim_ms());
+}
+
+char trace[64];
+int ntrace;
+
+void tyield(int cnt) {
+	int i;
+	for(i = 0; i < cnt; i++) {
+		trace[ntrace++] = dccthread_name(dccthread_self())[0];
+		dccthread_yield();
+	}
+}
+
+void test(int _) {
+	dccthread_t *threads[3];
+	threads[0] = dccthread_create("three", tsleep, 3);
+	threads[1] = dccthread_create("one", tsleep, 1);
+	threads[2] = dccthread_create("two", tsleep, 2);
+	dccthread_wait_all(threads, 3);
+
+	threads[0] = dccthread_create("a", tyield, 5);
+	threads[1] = dccthread_create("b", tyield, 5);
+	threads[2] = dccthread_create("c", tyield, 5);
+	dccthread_wait_all(threads, 3);
+	printf("interleaving: %s\n", trace);
+	dccthread_exit();
+}
+
+int main(int argc, char **argv)
+{
+	dccthread_sim_seed(7);
+	dccthread_init(test, 0);
+}
@@ -0,0 +1,27 @@
+#!/bin/bash
+set -u
+
+i=23
+
+# the simulation build needs its own objects
+gcc -g -Wall -DDCCTHREAD_SIM -c dccthread.c -o dccthread_sim.o &>> gcc.log
+gcc -g -Wall -DDCCTHREAD_SIM -I. tests/test$i.c dccthread_sim.o dlist.o -o test$i -lrt &>> gcc.log
+rm -f dccthread_sim.o
+if [ ! -x test$i ] ; then
+    echo "[$i] compilation error"
+    exit 1 ;
+fi
+
+# the same seed must give the same run twice
+./test$i > test$i.out 2> test$i.err
+./test$i > test$i.again.out 2>> test$i.err
+rm -f test$i
+
+if ! diff tests/test$i.out test$i.out &> /dev/null ||
+        ! diff test$i.out test$i.again.out &> /dev/null ; then
+    echo "[$i] output for test$i does not match"
+    exit 1
+fi
+
+rm -f test$i.out test$i.again.out test$i.err
+exit 0
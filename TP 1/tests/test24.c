@@ -0,0 +1,51 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "dccthread.h"
+
+#define NSLEEPERS 32
+
+/* every sleeper's timer fires while the main thread spins without
+ * calling the library, so all wakeups pile up on the lock-free stack
+ * before the manager drains it */
+
+int order[NSLEEPERS], nwoken;
+
+void spin(int msec) {
+	struct timespec start, now;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	do {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	} while((now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000 < msec);
+}
+
+void tsleep(int i) {
+	struct timespec ts = {0, (i + 1) * 1000000};
+	dccthread_sleep(ts);
+	order[nwoken++] = i;
+}
+
+void test(int _) {
+	dccthread_t *threads[NSLEEPERS];
+	struct timespec slice = {10, 0};
+	int i, sorted = 1;
+
+	dccthread_set_timeslice(slice);
+	for(i = 0; i < NSLEEPERS; i++)
+		threads[i] = dccthread_create("sleeper", tsleep, i);
+	dccthread_yield();
+	spin(NSLEEPERS + 50);
+	printf("woken before the drain: %d\n", nwoken);
+	dccthread_wait_all(threads, NSLEEPERS);
+
+	for(i = 0; i < NSLEEPERS; i++)
+		if(order[i] != i)
+			sorted = 0;
+	printf("woken: %d, in timer order: %d\n", nwoken, sorted);
+	dccthread_exit();
+}
+
+int main(int argc, char **argv)
+{
+	dccthread_init(test, 0);
+}
@@ -0,0 +1,39 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <sched.h>
+#include "dccthread.h"
+
+int pinned;
+
+int affinity_is_pinned(void) {
+	cpu_set_t set;
+	if(sched_getaffinity(0, sizeof(set), &set) == -1)
+		return 0;
+	return CPU_COUNT(&set) == 1 && CPU_ISSET(pinned, &set);
+}
+
+void tcheck(int _) {
+	dccthread_yield();
+	printf("%s runs on the pinned cpu: %d\n", dccthread_name(dccthread_self()),
+			sched_getcpu() == pinned);
+}
+
+void test(int _) {
+	dccthread_t *threads[2];
+	pinned = dccthread_set_cpu(DCCTHREAD_CPU_CURRENT);
+	printf("pinned to the current cpu: %d\n", pinned >= 0);
+	printf("affinity holds only that cpu: %d\n", affinity_is_pinned());
+	printf("negative cpu: %d\n", dccthread_set_cpu(-5));
+	printf("cpu past CPU_SETSIZE: %d\n", dccthread_set_cpu(CPU_SETSIZE));
+	printf("pinning kept after errors: %d\n", affinity_is_pinned());
+	threads[0] = dccthread_create("a", tcheck, 0);
+	threads[1] = dccthread_create("b", tcheck, 0);
+	dccthread_wait_all(threads, 2);
+	dccthread_exit();
+}
+
+int main(int argc, char **argv)
+{
+	dccthread_init(test, 0);
+}
@@ -0,0 +1,98 @@
+/* Aggregate page-fault throughput of the MMU server.
+ *
+ * usage: faultrate NCLIENTS NPAGES NLOOPS
+ *
+ * Forks NCLIENTS processes.  Each allocates NPAGES pages, waits until
+ * every client is ready, and then writes to all of its pages NLOOPS
+ * times; with fewer frames than pages in use, nearly every access
+ * faults.  Prints the wall-clock time from the release of the clients
+ * until all of them finish; bench/faultrate.sh divides the number of
+ * pager_fault lines the MMU printed by it. */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "uvm.h"
+
+static void client(int npages, int nloops, int ready, int start)
+{
+	uvm_create();
+	char **pages = malloc(npages * sizeof(pages[0]));
+	for(int i = 0; i < npages; ++i) {
+		pages[i] = uvm_extend();
+		if(!pages[i]) {
+			npages = i;
+			break;
+		}
+	}
+	char c = 0;
+	if(write(ready, &c, 1) != 1) exit(EXIT_FAILURE);
+	if(read(start, &c, 1) == -1) exit(EXIT_FAILURE);
+	for(int l = 0; l < nloops; ++l)
+		for(int i = 0; i < npages; ++i)
+			pages[i][l % 64] = (char)l;
+	/* every page went through the pager many times; check that the
+	 * last writes survived being swapped out and back in. */
+	for(int l = nloops > 64 ? nloops - 64 : 0; l < nloops; ++l)
+		for(int i = 0; i < npages; ++i)
+			if(pages[i][l % 64] != (char)l) exit(EXIT_FAILURE);
+	exit(EXIT_SUCCESS);
+}
+
+int main(int argc, char **argv)
+{
+	if(argc != 4) {
+		fprintf(stderr, "usage: %s NCLIENTS NPAGES NLOOPS\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+	int nclients = atoi(argv[1]);
+	int npages = atoi(argv[2]);
+	int nloops = atoi(argv[3]);
+
+	/* clients report on `ready` once set up and block on `start` until
+	 * the parent closes its end, so they all fault at the same time. */
+	int ready[2], start[2];
+	if(pipe(ready) == -1 || pipe(start) == -1) {
+		perror("pipe");
+		exit(EXIT_FAILURE);
+	}
+	for(int i = 0; i < nclients; ++i) {
+		pid_t pid = fork();
+		if(pid == -1) {
+			perror("fork");
+			exit(EXIT_FAILURE);
+		}
+		if(pid == 0) {
+			close(ready[0]);
+			close(start[1]);
+			client(npages, nloops, ready[1], start[0]);
+		}
+	}
+	close(ready[1]);
+	close(start[0]);
+	char c;
+	for(int i = 0; i < nclients; ++i)
+		if(read(ready[0], &c, 1) != 1) break;
+
+	struct timespec begin, end;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	close(start[1]);
+	int failed = 0;
+	for(int i = 0; i < nclients; ++i) {
+		int status;
+		wait(&status);
+		if(!WIFEXITED(status) || WEXITSTATUS(status) != 0) failed++;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	double secs = (end.tv_sec - begin.tv_sec) +
+			(end.tv_nsec - begin.tv_nsec) / 1e9;
+	printf("%.6f\n", secs);
+	if(failed) fprintf(stderr, "%d of %d clients failed\n", failed, nclients);
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
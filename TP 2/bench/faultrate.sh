@@ -0,0 +1,51 @@
+#!/bin/bash
+set -u
+
+# Aggregate faults per second as the number of clients grows, for the
+# threaded server, the epoll server (mmu -e) and the threaded server
+# with the page cleaner (mmu -c $CLEAN).  Run from the directory with
+# the Makefile after `make`.  The readahead mode runs the threaded
+# server with sequential-fault readahead (mmu -r $READAHEAD); it only
+# pays off when NPAGES is larger than one page.  Set MODES to run a
+# subset, POLICY to run every mode with another page replacement
+# policy (mmu -p), and LATENCY=1 to also print the MMU's fault latency
+# histogram (mmu -l) per run.
+#
+# usage: bench/faultrate.sh [NPAGES] [NLOOPS] [CLIENTS...]
+
+NPAGES=${1:-4}
+NLOOPS=${2:-200}
+shift $(( $# < 2 ? $# : 2 ))
+CLIENTS=${*:-1 2 4 8 16 32 64}
+FRAMES=16
+BLOCKS=1024
+MODES=${MODES:-thread event cleaner readahead}
+CLEAN=${CLEAN:-25}
+READAHEAD=${READAHEAD:-8}
+LATENCY=${LATENCY:-0}
+POLICY=${POLICY:-}
+
+printf "%-9s %8s %10s %10s %12s\n" mode clients faults seconds faults/s
+for mode in $MODES ; do
+    flags=""
+    [ $mode = event ] && flags="-e"
+    [ $mode = cleaner ] && flags="-c $CLEAN"
+    [ $mode = readahead ] && flags="-r $READAHEAD"
+    [ -n "$POLICY" ] && flags="$flags -p $POLICY"
+    [ $LATENCY = 1 ] && flags="$flags -l"
+    for n in $CLIENTS ; do
+        rm -rf mmu.sock mmu.pmem.img.*
+        ./bin/mmu $flags $FRAMES $BLOCKS > bench.mmu.out 2>&1 &
+        # by pid: a server that exits fast leaves %1 stale in the job table
+        mmupid=$!
+        sleep 1s
+        secs=$(./bin/faultrate $n $NPAGES $NLOOPS)
+        kill -SIGINT $mmupid
+        wait
+        faults=$(grep -c '^pager_fault' bench.mmu.out)
+        rate=$(awk -v f=$faults -v s=$secs 'BEGIN { printf "%.0f", f / s }')
+        printf "%-9s %8d %10d %10.3f %12s\n" $mode $n $faults $secs $rate
+        [ $LATENCY = 1 ] && grep -E '^(fault latency| +[0-9]+-)' bench.mmu.out
+    done
+done
+rm -rf mmu.sock mmu.pmem.img.* bench.mmu.out
@@ -0,0 +1,25 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "uvm.h"
+
+int num_pages = 64; /* test with mmu -r 16 32 64 */
+
+int main(void) {
+	uvm_create();
+	char **pages = malloc(num_pages * sizeof(pages[0]));
+	for(int i = 0; i < num_pages; ++i) {
+		pages[i] = uvm_extend();
+	}
+
+	/* read-only sequential stream: pages brought in ahead of time
+	 * are never written, so the process does not fault on them */
+	int sum = 0;
+	for(int pass = 0; pass < 2; ++pass) {
+		for(int i = 0; i < num_pages; ++i) {
+			sum += pages[i][0];
+		}
+	}
+	printf("read %d pages twice, sum %d\n", num_pages, sum);
+	exit(EXIT_SUCCESS);
+}
@@ -10,3 +10,37 @@
 10 4 8 0
 11 2 3 1
 12 256 1024 1
+1 4 8 2 -p arc
+2 4 8 2 -p arc
+3 4 8 2 -p arc
+4 4 8 2 -p arc
+5 4 8 2 -p arc
+6 4 8 2 -p arc
+7 4 8 2 -p arc
+8 4 8 2 -p arc
+9 4 8 2 -p arc
+10 4 8 2 -p arc
+11 2 3 2 -p arc
+1 4 8 2 -r 4
+2 4 8 2 -r 4
+3 4 8 2 -r 4
+4 4 8 2 -r 4
+5 4 8 2 -r 4
+6 4 8 2 -r 4
+7 4 8 2 -r 4
+8 4 8 2 -r 4
+9 4 8 2 -r 4
+10 4 8 2 -r 4
+11 2 3 2 -r 4
+1 4 8 2 -c 50
+2 4 8 2 -c 50
+3 4 8 2 -c 50
+4 4 8 2 -c 50
+5 4 8 2 -c 50
+6 4 8 2 -c 50
+7 4 8 2 -c 50
+8 4 8 2 -c 50
+9 4 8 2 -c 50
+10 4 8 2 -c 50
+11 2 3 2 -c 50
+13 32 64 0 -r 16
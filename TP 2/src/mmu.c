@@ -1,3 +1,5 @@
+#define _GNU_SOURCE
+#include <sys/epoll.h>
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -7,24 +9,33 @@
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <pthread.h>
 #include <signal.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "log.h"
 
 #include "pager.h"
 #include "mmuproto.h"
+#include "ring.h"
 
 #define MMU_MAX_EVENTS 32
 #define MMU_MAX_SOCK 1024
-
-
-pid_t id2pid[UINT8_MAX];
-uint8_t nextid = 0;
+#define MMU_PID_TABLE_INIT 64
+#define MMU_CLIENT_INBUF 4096
+/* the event loop and its blocking waits recheck mmu->running this often */
+#define MMU_EVENT_TICK_MS 100
+/* acknowledgements are REMAP, CHPROT and their batch variants */
+#define MMU_ACK_TYPES 4
+/* fault latency histogram (-l): bucket b counts faults that took
+ * [2^(b-1), 2^b) microseconds, bucket 0 those under 1us */
+#define MMU_LAT_BUCKETS 24
 
 /****************************************************************************
  * structure definitions and static variables
@@ -38,14 +49,65 @@ struct mmu_data {/*{{{*/
 	int pmem_fd;
 	int sock;
 	struct mmu_client * sock2client[MMU_MAX_SOCK];
+	/* open-addressing table of clients keyed by pid.  slots of
+	 * exited clients hold MMU_CLIENT_REMOVED and are reused by
+	 * later creates.  `used` counts non-empty slots, `count` only
+	 * live clients.  guarded by `clients_lock`, which client
+	 * threads take from inside the pager. */
+	pthread_mutex_t clients_lock;
+	struct mmu_client **pid2client;
+	int pid2client_cap;
+	int pid2client_used;
+	int pid2client_count;
+	int nextid;
+	/* event mode (-e): one thread serves every client from an
+	 * epoll loop.  clients with buffered requests, or closed and
+	 * waiting to be freed, queue on `pending`. */
+	int event;
+	int epfd;
+	struct mmu_client *pending;
+	int lathist;
+	_Atomic unsigned long lat[MMU_LAT_BUCKETS];
 };/*}}}*/
 struct mmu_client {/*{{{*/
 	int running;
 	int sock;
 	pid_t pid;
+	int id; /* sequential id printed in place of the pid */
 	pthread_t thread;
+	pthread_t worker;
+	/* shared rings, once the client asks for them with RING_REQ.
+	 * other clients' threads also talk to this client from inside
+	 * the pager, so each direction has a local lock. */
+	struct ring_shm *ring;
+	pthread_mutex_t ring_tx;
+	pthread_mutex_t ring_rx;
+	/* the client's own thread is the only reader of its stream.  it
+	 * counts acknowledgements in `acks` by type and queues requests
+	 * in `inbuf` for `worker`, which serves them and may block in
+	 * the pager meanwhile.  faults of different clients run in the
+	 * pager at the same time, so two threads may message this
+	 * client at once; each holds `call` from its send until the
+	 * count of its acknowledgement type moves. */
+	pthread_mutex_t call;
+	pthread_mutex_t ack_lock;
+	pthread_cond_t ack_cond;
+	unsigned acks[MMU_ACK_TYPES];
+	pthread_mutex_t req_lock;
+	pthread_cond_t req_cond;
+	int reading; /* the client's thread still fills `inbuf` */
+	int closed; /* hung up, guarded by `ack_lock` */
+	int destroyed; /* pager_destroy already ran */
+	/* requests read but not yet served (by the loop in event mode),
+	 * and the link in mmu->pending. */
+	char inbuf[MMU_CLIENT_INBUF];
+	size_t inlen;
+	int pending;
+	struct mmu_client *next_pending;
 };/*}}}*/
 static struct mmu_data *mmu = NULL;
+static struct mmu_client mmu_client_removed;
+#define MMU_CLIENT_REMOVED (&mmu_client_removed)
 const char *pmem = NULL;
 static size_t PAGESIZE = 0;
 
@@ -54,14 +116,42 @@ static size_t PAGESIZE = 0;
  ***************************************************************************/
 static void mmu_destroy(void);
 static void mmu_client_destroy(struct mmu_client *c);
+static int mmu_client_hangup(struct mmu_client *c);
+static void mmu_client_finish(struct mmu_client *c);
 static void mmu_shutdown_action(int signum, siginfo_t *si, void *context);
 static void mmu_accept_loop(void);
+static void mmu_event_loop(void);
+static struct mmu_client * mmu_client_new(int sock);
 static void * mmu_client_thread(void *vclient);
+static void * mmu_client_worker(void *vclient);
+static int mmu_client_dispatch(struct mmu_client *c, uint32_t type);
+static void mmu_client_insert(struct mmu_client *c);
+static void mmu_client_remove(struct mmu_client *c);
+static void mmu_client_free(struct mmu_client *c);
+static ssize_t mmu_client_send(struct mmu_client *c, const void *buf,
+		size_t len);
+static ssize_t mmu_client_recv(struct mmu_client *c, void *buf, size_t len,
+		int flags);
+static ssize_t mmu_client_read(struct mmu_client *c, void *buf, size_t len,
+		int flags);
+static int mmu_client_queue(struct mmu_client *c, uint32_t type);
+static void mmu_client_ack(struct mmu_client *c, uint32_t type);
+struct mmu_client * mmu_client_search(pid_t pid);
+static ssize_t mmu_event_send(struct mmu_client *c, const void *buf,
+		size_t len);
+static ssize_t mmu_event_recv(struct mmu_client *c, void *buf, size_t len,
+		int flags);
+static void mmu_event_defer(struct mmu_client *c);
+static int mmu_event_take(struct mmu_client *c, uint32_t type);
+static size_t mmu_proto_req_size(uint32_t type);
+static int mmu_ack_index(uint32_t type);
+static int mmu_client_call(struct mmu_client *c, const void *buf, size_t len,
+		uint32_t acktype);
+static void mmu_lat_record(const struct timespec *start);
+static void mmu_lat_print(void);
 
 int get_pid_id(pid_t pid) {
-	int i = 0;
-	for(; id2pid[i] != pid; i++);
-	return i;
+	return mmu_client_search(pid)->id;
 }
 
 /****************************************************************************
@@ -87,6 +177,19 @@ void mmu_init(int npages, int nblocks)/*{{{*/
 	mmu_init_sock();
 	mmu_init_sigs();
 	memset(mmu->sock2client, 0, MMU_MAX_SOCK*sizeof(mmu->sock2client[0]));
+
+	pthread_mutex_init(&mmu->clients_lock, NULL);
+	mmu->pid2client_cap = MMU_PID_TABLE_INIT;
+	mmu->pid2client = calloc(mmu->pid2client_cap, sizeof(*mmu->pid2client));
+	if(!mmu->pid2client) logea(__FILE__, __LINE__, NULL);
+	mmu->pid2client_used = 0;
+	mmu->pid2client_count = 0;
+	mmu->nextid = 0;
+	mmu->lathist = 0;
+	for(int i = 0; i < MMU_LAT_BUCKETS; ++i) atomic_init(&mmu->lat[i], 0);
+	mmu->event = 0;
+	mmu->epfd = -1;
+	mmu->pending = NULL;
 }/*}}}*/
 
 void mmu_init_disk(int nblocks)/*{{{*/
@@ -160,9 +263,12 @@ void mmu_destroy(void)/*{{{*/
 		if(!mmu->sock2client[i]) continue;
 		mmu_client_destroy(mmu->sock2client[i]);
 	}
+	free(mmu->pid2client);
+	pthread_mutex_destroy(&mmu->clients_lock);
 	munmap(mmu->pmem, mmu->npages * PAGESIZE);
 	free(mmu->disk);
 	close(mmu->sock);
+	if(mmu->epfd != -1) close(mmu->epfd);
 	unlink(MMU_PROTO_UNIX_PATH);
 	free(mmu);
 	mmu = NULL;
@@ -190,72 +296,252 @@ void mmu_accept_loop(void)/*{{{*/
 		if(nsock == -1) continue;
 		logd(LOG_DEBUG, "%s: sock %d\n", __func__, nsock);
 		logd(LOG_DEBUG, "%s: creating thread\n", __func__);
-		struct mmu_client *c = malloc(sizeof(*c));
-		if(!c) logea(__FILE__, __LINE__, NULL);
-		mmu->sock2client[nsock] = c;
-		c->running = 1;
-		c->sock = nsock;
-		c->pid = 0;
+		struct mmu_client *c = mmu_client_new(nsock);
 		pthread_create(&c->thread, NULL, mmu_client_thread, c);
 		pthread_detach(c->thread);
 	}
 	logd(LOG_DEBUG, "%s: exiting\n", __func__);
 }/*}}}*/
 
+struct mmu_client * mmu_client_new(int sock)/*{{{*/
+{
+	struct mmu_client *c = malloc(sizeof(*c));
+	if(!c) logea(__FILE__, __LINE__, NULL);
+	mmu->sock2client[sock] = c;
+	c->running = 1;
+	c->sock = sock;
+	c->pid = 0;
+	c->id = -1;
+	c->ring = NULL;
+	pthread_mutex_init(&c->ring_tx, NULL);
+	pthread_mutex_init(&c->ring_rx, NULL);
+	pthread_mutex_init(&c->call, NULL);
+	pthread_mutex_init(&c->ack_lock, NULL);
+	pthread_cond_init(&c->ack_cond, NULL);
+	memset(c->acks, 0, sizeof(c->acks));
+	pthread_mutex_init(&c->req_lock, NULL);
+	pthread_cond_init(&c->req_cond, NULL);
+	c->reading = 1;
+	c->closed = 0;
+	c->destroyed = 0;
+	c->inlen = 0;
+	c->pending = 0;
+	c->next_pending = NULL;
+	return c;
+}/*}}}*/
+
 static void mmu_client_log(const struct mmu_client *c, const char *fname, const char *msg);
 static void mmu_client_create(struct mmu_client *c);
 static void mmu_client_extend(struct mmu_client *c);
 static void mmu_client_syslog(struct mmu_client *c);
 static void mmu_client_segv(struct mmu_client *c);
 static void mmu_client_exit(struct mmu_client *c);
+static void mmu_client_ring(struct mmu_client *c);
 
+/* the client's thread reads everything the client sends.  it takes
+ * acknowledgements itself and queues requests for the worker, so an
+ * acknowledgement never waits behind a request stuck in the pager.
+ * once the stream ends it waits for the worker and, unless the mmu is
+ * shutting down, destroys and frees the client. */
 void * mmu_client_thread(void *vclient)/*{{{*/
 {
 	struct mmu_client *c = vclient;
+	pthread_create(&c->worker, NULL, mmu_client_worker, c);
 	while(mmu->running && c->running) {
 		mmu_client_log(c, __func__, "recv");
 		uint32_t type;
-		ssize_t cnt = recv(c->sock, &type, sizeof(type), MSG_PEEK);
+		ssize_t cnt = mmu_client_read(c, &type, sizeof(type), MSG_PEEK);
 		if(!mmu->running || !c->running) {
 			mmu_client_log(c, __func__, "breaking loop");
 			break;
 		}
 		if(cnt != sizeof(type)) goto out_client;
-		switch(type) {
-		case MMU_PROTO_CREATE_REQ:
-			mmu_client_create(c);
-			break;
-		case MMU_PROTO_EXTEND_REQ:
-			mmu_client_extend(c);
-			break;
-		case MMU_PROTO_SYSLOG_REQ:
-			mmu_client_syslog(c);
-			break;
-		case MMU_PROTO_SEGV_REQ:
-			mmu_client_segv(c);
-			break;
-		case MMU_PROTO_REMAP_REQ:
-		case MMU_PROTO_CHPROT_REQ:
-			/* these messages are handled by the pager thread */
-			break;
-		case MMU_PROTO_EXIT_REQ:
-			mmu_client_exit(c);
-			break;
-		default:
-			mmu_client_log(c, __func__, "invalid message type");
+		if(mmu_ack_index(type) != -1) {
+			if(mmu_client_read(c, &type, sizeof(type), 0) != sizeof(type))
+				goto out_client;
+			mmu_client_ack(c, type);
+		} else if(type == MMU_PROTO_RING_REQ) {
+			/* carries a descriptor, so it is served here */
+			mmu_client_ring(c);
+		} else if(mmu_client_queue(c, type) == -1) {
 			goto out_client;
-			break;
 		}
 	}
-	mmu_client_log(c, __func__, "finished");
-	free(c);
-	pthread_exit(NULL);
+	goto out_worker;
 
 	out_client:
 	mmu_client_destroy(c);
+	out_worker:
+	pthread_mutex_lock(&c->req_lock);
+	c->reading = 0;
+	pthread_cond_broadcast(&c->req_cond);
+	pthread_mutex_unlock(&c->req_lock);
+	if(!mmu->running) pthread_exit(NULL); /* worker may be in the pager */
+	pthread_join(c->worker, NULL);
+	mmu_client_finish(c);
+	close(c->sock);
+	mmu_client_log(c, __func__, "finished");
+	mmu_client_free(c);
 	pthread_exit(NULL);
 }/*}}}*/
 
+/* serves the requests queued by the client's thread, one at a time. */
+void * mmu_client_worker(void *vclient)/*{{{*/
+{
+	struct mmu_client *c = vclient;
+	while(c->running) {
+		uint32_t type;
+		if(mmu_client_recv(c, &type, sizeof(type), MSG_PEEK) != sizeof(type))
+			break;
+		if(mmu_client_dispatch(c, type) == -1) {
+			mmu_client_destroy(c);
+			break;
+		}
+	}
+	return NULL;
+}/*}}}*/
+
+int mmu_client_dispatch(struct mmu_client *c, uint32_t type)/*{{{*/
+{
+	switch(type) {
+	case MMU_PROTO_CREATE_REQ:
+		mmu_client_create(c);
+		break;
+	case MMU_PROTO_EXTEND_REQ:
+		mmu_client_extend(c);
+		break;
+	case MMU_PROTO_SYSLOG_REQ:
+		mmu_client_syslog(c);
+		break;
+	case MMU_PROTO_SEGV_REQ:
+		mmu_client_segv(c);
+		break;
+	case MMU_PROTO_EXIT_REQ:
+		mmu_client_exit(c);
+		break;
+	case MMU_PROTO_RING_REQ:
+		mmu_client_ring(c);
+		break;
+	default:
+		mmu_client_log(c, __func__, "invalid message type");
+		return -1;
+	}
+	return 0;
+}/*}}}*/
+
+void mmu_client_free(struct mmu_client *c)/*{{{*/
+{
+	/* only the client's own thread unmaps the rings: other threads
+	 * may still be waiting on them until ring_close wakes them. */
+	if(c->ring) ring_shm_unmap(c->ring);
+	pthread_mutex_destroy(&c->ring_tx);
+	pthread_mutex_destroy(&c->ring_rx);
+	pthread_mutex_destroy(&c->call);
+	pthread_mutex_destroy(&c->ack_lock);
+	pthread_cond_destroy(&c->ack_cond);
+	pthread_mutex_destroy(&c->req_lock);
+	pthread_cond_destroy(&c->req_cond);
+	free(c);
+}/*}}}*/
+
+ssize_t mmu_client_send(struct mmu_client *c, const void *buf, size_t len)/*{{{*/
+{
+	if(mmu->event) return mmu_event_send(c, buf, len);
+	if(c->ring)
+		return ring_send(c->ring, &c->ring->s2c, &c->ring_tx, c->sock,
+				buf, len);
+	/* a client that died must not take the mmu down with SIGPIPE */
+	return send(c->sock, buf, len, MSG_NOSIGNAL);
+}/*}}}*/
+
+/* handlers read their request from what the client's thread queued
+ * (or the loop buffered, in event mode). */
+ssize_t mmu_client_recv(struct mmu_client *c, void *buf, size_t len,/*{{{*/
+		int flags)
+{
+	if(mmu->event) return mmu_event_recv(c, buf, len, flags);
+	ssize_t n = 0;
+	pthread_mutex_lock(&c->req_lock);
+	while(c->inlen < len && c->reading)
+		pthread_cond_wait(&c->req_cond, &c->req_lock);
+	if(c->inlen >= len) {
+		memcpy(buf, c->inbuf, len);
+		if(!(flags & MSG_PEEK)) {
+			c->inlen -= len;
+			memmove(c->inbuf, c->inbuf + len, c->inlen);
+		}
+		n = len;
+	}
+	pthread_mutex_unlock(&c->req_lock);
+	return n;
+}/*}}}*/
+
+/* reads from the client's stream; only the client's thread calls it. */
+ssize_t mmu_client_read(struct mmu_client *c, void *buf, size_t len,/*{{{*/
+		int flags)
+{
+	if(c->ring)
+		return ring_recv(c->ring, &c->ring->c2s, &c->ring_rx, c->sock,
+				buf, len, flags & MSG_PEEK);
+	return recv(c->sock, buf, len, flags | MSG_WAITALL);
+}/*}}}*/
+
+/* moves the request at the head of the stream to c->inbuf.  the client
+ * waits for each reply, so a full buffer means a broken client. */
+int mmu_client_queue(struct mmu_client *c, uint32_t type)/*{{{*/
+{
+	char buf[MMU_CLIENT_INBUF];
+	size_t size = mmu_proto_req_size(type);
+	if(mmu_client_read(c, buf, size, 0) != (ssize_t)size) return -1;
+	pthread_mutex_lock(&c->req_lock);
+	int full = c->inlen + size > sizeof(c->inbuf);
+	if(!full) {
+		memcpy(c->inbuf + c->inlen, buf, size);
+		c->inlen += size;
+		pthread_cond_broadcast(&c->req_cond);
+	}
+	pthread_mutex_unlock(&c->req_lock);
+	if(full) mmu_client_log(c, __func__, "input buffer full");
+	return full ? -1 : 0;
+}/*}}}*/
+
+void mmu_client_ack(struct mmu_client *c, uint32_t type)/*{{{*/
+{
+	pthread_mutex_lock(&c->ack_lock);
+	c->acks[mmu_ack_index(type)]++;
+	pthread_cond_broadcast(&c->ack_cond);
+	pthread_mutex_unlock(&c->ack_lock);
+}/*}}}*/
+
+/* sends a REMAP/CHPROT (or batch) message and waits for its
+ * acknowledgement, a bare type.  returns -1 if the client went away. */
+int mmu_client_call(struct mmu_client *c, const void *buf, size_t len,/*{{{*/
+		uint32_t acktype)
+{
+	int ret = -1;
+	pthread_mutex_lock(&c->call);
+	if(mmu->event) {
+		if(mmu_client_send(c, buf, len) == (ssize_t)len &&
+				mmu_event_take(c, acktype) == 0)
+			ret = 0;
+		pthread_mutex_unlock(&c->call);
+		return ret;
+	}
+	int k = mmu_ack_index(acktype);
+	pthread_mutex_lock(&c->ack_lock);
+	unsigned seen = c->acks[k];
+	pthread_mutex_unlock(&c->ack_lock);
+	if(mmu_client_send(c, buf, len) == (ssize_t)len) {
+		pthread_mutex_lock(&c->ack_lock);
+		while(c->acks[k] == seen && !c->closed)
+			pthread_cond_wait(&c->ack_cond, &c->ack_lock);
+		if(c->acks[k] != seen) ret = 0;
+		pthread_mutex_unlock(&c->ack_lock);
+	}
+	pthread_mutex_unlock(&c->call);
+	return ret;
+}/*}}}*/
+
 void mmu_client_log(const struct mmu_client *c, const char *fname, const char *msg)/*{{{*/
 {
 	logd(LOG_DEBUG, "%s sock %d pid %d: %s\n", fname, c->sock,
@@ -266,13 +552,13 @@ void mmu_client_create(struct mmu_client *c)/*{{{*/
 {
 	char msg[96];
 	struct mmu_proto_create_req req;
-	if(recv(c->sock, &req, sizeof(req), 0) != sizeof(req))
+	if(mmu_client_recv(c, &req, sizeof(req), 0) != sizeof(req))
 		goto out_client;
 	assert(req.type == MMU_PROTO_CREATE_REQ);
 
 	c->pid = (pid_t)req.pid;
-	int id = nextid;
-	id2pid[nextid++] = c->pid;
+	mmu_client_insert(c);
+	int id = c->id;
 	printf("pager_create pid %d\n", id);
 	pager_create(c->pid);
 	snprintf(msg, 96, "create pid %d", id);
@@ -282,7 +568,7 @@ void mmu_client_create(struct mmu_client *c)/*{{{*/
 	rep.type = MMU_PROTO_CREATE_REP;
 	memset(rep.pmem_fn, '\0', MMU_PROTO_PATH_MAX);
 	strncat(rep.pmem_fn, mmu->pmem_fn, MMU_PROTO_PATH_MAX);
-	if(send(c->sock, &rep, sizeof(rep), 0) != sizeof(rep))
+	if(mmu_client_send(c, &rep, sizeof(rep)) != sizeof(rep))
 		goto out_client;
 	return;
 
@@ -294,11 +580,11 @@ void mmu_client_extend(struct mmu_client *c)/*{{{*/
 {
 	char msg[96];
 	struct mmu_proto_extend_req req;
-	if(recv(c->sock, &req, sizeof(req), 0) != sizeof(req))
+	if(mmu_client_recv(c, &req, sizeof(req), 0) != sizeof(req))
 		goto out_client;
 	assert(req.type == MMU_PROTO_EXTEND_REQ);
 
-	int id = get_pid_id(c->pid);
+	int id = c->id;
 	void *vaddr = pager_extend(c->pid);
 	printf("pager_extend pid %d vaddr %p\n", id, vaddr);
 	snprintf(msg, 96, "extend vaddr %p", vaddr);
@@ -307,7 +593,7 @@ void mmu_client_extend(struct mmu_client *c)/*{{{*/
 	struct mmu_proto_extend_rep rep;
 	rep.type = MMU_PROTO_EXTEND_REP;
 	rep.vaddr = (intptr_t)vaddr;
-	if(send(c->sock, &rep, sizeof(rep), 0) != sizeof(rep))
+	if(mmu_client_send(c, &rep, sizeof(rep)) != sizeof(rep))
 		goto out_client;
 	return;
 
@@ -319,14 +605,14 @@ void mmu_client_syslog(struct mmu_client *c)/*{{{*/
 {
 	char msg[96];
 	struct mmu_proto_syslog_req req;
-	if(recv(c->sock, &req, sizeof(req), 0) != sizeof(req))
+	if(mmu_client_recv(c, &req, sizeof(req), 0) != sizeof(req))
 		goto out_client;
 	assert(req.type == MMU_PROTO_SYSLOG_REQ);
 
 	assert(req.addr < UINTPTR_MAX);
 	void *vaddr = (void *)(uintptr_t)req.addr;
 	size_t len = (size_t)req.len;
-	int id = get_pid_id(c->pid);
+	int id = c->id;
 	printf("pager_syslog pid %d %p\n", id, vaddr);
 	int status = pager_syslog(c->pid, vaddr, len);
 	snprintf(msg, 96, "vaddr %p len %zu retcode %d", vaddr, len, status);
@@ -335,7 +621,7 @@ void mmu_client_syslog(struct mmu_client *c)/*{{{*/
 	struct mmu_proto_syslog_rep rep;
 	rep.type = MMU_PROTO_SYSLOG_REP;
 	rep.retcode = (uint32_t)status;
-	if(send(c->sock, &rep, sizeof(rep), 0) != sizeof(rep))
+	if(mmu_client_send(c, &rep, sizeof(rep)) != sizeof(rep))
 		goto out_client;
 	return;
 
@@ -347,7 +633,7 @@ void mmu_client_segv(struct mmu_client *c)/*{{{*/
 {
 	char msg[96];
 	struct mmu_proto_segv_req req;
-	if(recv(c->sock, &req, sizeof(req), 0) != sizeof(req))
+	if(mmu_client_recv(c, &req, sizeof(req), 0) != sizeof(req))
 		goto out_client;
 	assert(req.type == MMU_PROTO_SEGV_REQ);
 
@@ -357,13 +643,16 @@ void mmu_client_segv(struct mmu_client *c)/*{{{*/
 	snprintf(msg, 96, "vaddr %p code %d", vaddr, code);
 	mmu_client_log(c, __func__, msg);
 
-	int id = get_pid_id(c->pid);
+	int id = c->id;
 	printf("pager_fault pid %d vaddr %p\n", id, vaddr);
+	struct timespec start;
+	if(mmu->lathist) clock_gettime(CLOCK_MONOTONIC, &start);
 	pager_fault(c->pid, vaddr);
+	if(mmu->lathist) mmu_lat_record(&start);
 
 	struct mmu_proto_segv_rep rep;
 	rep.type = MMU_PROTO_SEGV_REP;
-	if(send(c->sock, &rep, sizeof(rep), 0) != sizeof(rep))
+	if(mmu_client_send(c, &rep, sizeof(rep)) != sizeof(rep))
 		goto out_client;
 	return;
 
@@ -374,37 +663,419 @@ void mmu_client_segv(struct mmu_client *c)/*{{{*/
 void mmu_client_exit(struct mmu_client *c)/*{{{*/
 {
 	struct mmu_proto_exit_req req;
-	if(recv(c->sock, &req, sizeof(req), 0) != sizeof(req))
+	if(mmu_client_recv(c, &req, sizeof(req), 0) != sizeof(req))
 		goto out_client;
 	mmu_client_log(c, __func__, "exiting cleanly");
 	assert(req.type == MMU_PROTO_EXIT_REQ);
 	assert(c->pid);
-	int id = get_pid_id(c->pid);
+	int id = c->id;
 	printf("pager_destroy pid %d\n", id);
-	pager_destroy(c->pid);
+	mmu_client_finish(c);
 
 	struct mmu_proto_segv_rep rep;
 	rep.type = MMU_PROTO_EXIT_REP;
-	send(c->sock, &rep, sizeof(rep), 0); /* ignoring return value */
+	mmu_client_send(c, &rep, sizeof(rep)); /* ignoring return value */
+	mmu_client_hangup(c);
+	return;
 
-	mmu->sock2client[c->sock] = NULL;
-	c->running = 0;
-	close(c->sock);
+	out_client:
+	mmu_client_destroy(c);
+}/*}}}*/
+
+void mmu_client_ring(struct mmu_client *c)/*{{{*/
+{
+	struct mmu_proto_ring_req req;
+	int fd = -1;
+	if(mmu->event) {
+		/* the event loop cannot wait on the rings' futexes; the
+		 * passed descriptor was dropped by recv, so refuse and the
+		 * client stays on the socket. */
+		if(mmu_client_recv(c, &req, sizeof(req), 0) != sizeof(req))
+			goto out_client;
+	} else if(ring_recvfd(c->sock, &fd, &req, sizeof(req)) != sizeof(req))
+		goto out_client;
+	assert(req.type == MMU_PROTO_RING_REQ);
+
+	struct mmu_proto_ring_rep rep;
+	rep.type = MMU_PROTO_RING_REP;
+	rep.status = -1;
+	struct ring_shm *ring = fd == -1 ? NULL : ring_shm_map(fd);
+	if(fd != -1) close(fd);
+	if(ring) rep.status = 0;
+	mmu_client_log(c, __func__, ring ? "using shared rings" : "staying on socket");
+
+	/* the reply still goes over the socket; the client switches
+	 * only after reading it. */
+	if(mmu_client_send(c, &rep, sizeof(rep)) != sizeof(rep)) {
+		if(ring) ring_shm_unmap(ring);
+		goto out_client;
+	}
+	c->ring = ring;
 	return;
 
 	out_client:
 	mmu_client_destroy(c);
 }/*}}}*/
 
+/* pager threads get here when another client fails while they hold the
+ * pager's locks, so this only hangs up; the client's own thread (or the
+ * event loop) runs pager_destroy later through mmu_client_finish. */
 void mmu_client_destroy(struct mmu_client *c)/*{{{*/
 {
+	if(!mmu_client_hangup(c)) return; /* exit or an earlier error got here first */
 	loge(LOG_WARN, __FILE__, __LINE__);
 	mmu_client_log(c, __func__, "running");
+}/*}}}*/
+
+/* stops all traffic with `c` and wakes whoever waits on it.  returns 0
+ * if it was already hung up.  in threaded mode the socket is only shut
+ * down: the client's thread may be blocked reading it, and closes it. */
+int mmu_client_hangup(struct mmu_client *c)/*{{{*/
+{
+	pthread_mutex_lock(&c->ack_lock);
+	int closed = c->closed;
+	c->closed = 1;
+	pthread_cond_broadcast(&c->ack_cond);
+	pthread_mutex_unlock(&c->ack_lock);
+	if(closed) return 0;
 	mmu->sock2client[c->sock] = NULL;
 	c->running = 0;
-	close(c->sock);
-	if(c->pid) { /* may get here before CREATE_REQ happens */
-		pager_destroy(c->pid);
+	if(c->ring) {
+		ring_close(&c->ring->c2s);
+		ring_close(&c->ring->s2c);
+	}
+	if(mmu->event) {
+		close(c->sock);
+		mmu_event_defer(c);
+	} else {
+		shutdown(c->sock, SHUT_RDWR);
+	}
+	return 1;
+}/*}}}*/
+
+void mmu_client_finish(struct mmu_client *c)/*{{{*/
+{
+	/* may get here before CREATE_REQ happens */
+	if(!c->pid || c->destroyed) return;
+	pager_destroy(c->pid);
+	mmu_client_remove(c);
+	c->destroyed = 1;
+}/*}}}*/
+
+static int mmu_pid_hash(pid_t pid, int cap)/*{{{*/
+{
+	return (int)(((uint32_t)pid * 2654435761u) & (uint32_t)(cap - 1));
+}/*}}}*/
+
+static void mmu_client_rehash(int cap)/*{{{*/
+{
+	struct mmu_client **old = mmu->pid2client;
+	int oldcap = mmu->pid2client_cap;
+	mmu->pid2client = calloc(cap, sizeof(*mmu->pid2client));
+	if(!mmu->pid2client) logea(__FILE__, __LINE__, NULL);
+	for(int i = 0; i < oldcap; ++i) {
+		if(!old[i] || old[i] == MMU_CLIENT_REMOVED) continue;
+		int j = mmu_pid_hash(old[i]->pid, cap);
+		while(mmu->pid2client[j]) j = (j + 1) & (cap - 1);
+		mmu->pid2client[j] = old[i];
+	}
+	free(old);
+	mmu->pid2client_cap = cap;
+	mmu->pid2client_used = mmu->pid2client_count;
+}/*}}}*/
+
+void mmu_client_insert(struct mmu_client *c)/*{{{*/
+{
+	pthread_mutex_lock(&mmu->clients_lock);
+	c->id = mmu->nextid++;
+	/* keep load (live + removed) under 3/4; only grow if live
+	 * clients need it, otherwise just purge removed slots. */
+	if((mmu->pid2client_used + 1) * 4 > mmu->pid2client_cap * 3) {
+		int cap = mmu->pid2client_cap;
+		if((mmu->pid2client_count + 1) * 2 > cap) cap *= 2;
+		mmu_client_rehash(cap);
+	}
+	int mask = mmu->pid2client_cap - 1;
+	int slot = -1;
+	for(int i = mmu_pid_hash(c->pid, mmu->pid2client_cap);;
+			i = (i + 1) & mask) {
+		struct mmu_client *e = mmu->pid2client[i];
+		if(e == MMU_CLIENT_REMOVED && slot == -1) slot = i;
+		if(!e) {
+			if(slot == -1) {
+				slot = i;
+				mmu->pid2client_used++;
+			}
+			break;
+		}
+	}
+	mmu->pid2client[slot] = c;
+	mmu->pid2client_count++;
+	pthread_mutex_unlock(&mmu->clients_lock);
+}/*}}}*/
+
+void mmu_client_remove(struct mmu_client *c)/*{{{*/
+{
+	/* may run twice for the same client (exit, then socket
+	 * error); only clear the slot if it still holds `c`. */
+	pthread_mutex_lock(&mmu->clients_lock);
+	int mask = mmu->pid2client_cap - 1;
+	for(int i = mmu_pid_hash(c->pid, mmu->pid2client_cap);
+			mmu->pid2client[i]; i = (i + 1) & mask) {
+		if(mmu->pid2client[i] != c) continue;
+		mmu->pid2client[i] = MMU_CLIENT_REMOVED;
+		mmu->pid2client_count--;
+		break;
+	}
+	pthread_mutex_unlock(&mmu->clients_lock);
+}/*}}}*/
+/*}}}*/
+
+/****************************************************************************
+ * event mode {{{
+ ***************************************************************************/
+/* reads whatever the socket has into c->inbuf.  returns the number
+ * of bytes read, 0 if the client is gone, and -1 if nothing is
+ * available and `block` is not set. */
+static ssize_t mmu_event_fill(struct mmu_client *c, int block)/*{{{*/
+{
+	if(c->closed) return 0;
+	if(c->inlen == sizeof(c->inbuf)) {
+		mmu_client_log(c, __func__, "input buffer full");
+		return block ? 0 : -1;
+	}
+	for(;;) {
+		ssize_t n = recv(c->sock, c->inbuf + c->inlen,
+				sizeof(c->inbuf) - c->inlen, MSG_DONTWAIT);
+		if(n > 0) {
+			c->inlen += n;
+			return n;
+		}
+		if(n == 0) return 0;
+		if(errno == EINTR) continue;
+		if(errno != EAGAIN && errno != EWOULDBLOCK) return 0;
+		if(!block) return -1;
+		if(!mmu->running) return 0;
+		struct pollfd pfd = { .fd = c->sock, .events = POLLIN };
+		poll(&pfd, 1, MMU_EVENT_TICK_MS);
+	}
+}/*}}}*/
+
+/* replies are small, so a full socket buffer is waited out in place. */
+ssize_t mmu_event_send(struct mmu_client *c, const void *buf, size_t len)/*{{{*/
+{
+	size_t off = 0;
+	while(off < len) {
+		if(c->closed) return -1;
+		ssize_t n = send(c->sock, (const char *)buf + off, len - off,
+				MSG_DONTWAIT | MSG_NOSIGNAL);
+		if(n > 0) {
+			off += n;
+			continue;
+		}
+		if(n == -1 && errno == EINTR) continue;
+		if(n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			if(!mmu->running) return -1;
+			struct pollfd pfd = { .fd = c->sock, .events = POLLOUT };
+			poll(&pfd, 1, MMU_EVENT_TICK_MS);
+			continue;
+		}
+		return -1;
+	}
+	return len;
+}/*}}}*/
+
+/* handlers consume requests the loop already buffered.  the pager's
+ * calls into mmu_resident and friends block here for the target's
+ * acknowledgement; anything read past it is served later. */
+ssize_t mmu_event_recv(struct mmu_client *c, void *buf, size_t len,/*{{{*/
+		int flags)
+{
+	while(c->inlen < len) {
+		if(mmu_event_fill(c, 1) <= 0) return 0;
+		mmu_event_defer(c);
+	}
+	memcpy(buf, c->inbuf, len);
+	if(!(flags & MSG_PEEK)) {
+		c->inlen -= len;
+		memmove(c->inbuf, c->inbuf + len, c->inlen);
+	}
+	return len;
+}/*}}}*/
+
+/* the loop thread may be serving a request of `c` itself, so requests
+ * the client sent before the acknowledgement can still sit unserved in
+ * the buffer; look past them. */
+int mmu_event_take(struct mmu_client *c, uint32_t type)/*{{{*/
+{
+	for(;;) {
+		size_t off = 0;
+		while(off + sizeof(uint32_t) <= c->inlen) {
+			uint32_t t;
+			memcpy(&t, c->inbuf + off, sizeof(t));
+			size_t size = mmu_proto_req_size(t);
+			if(t == type && off + size <= c->inlen) {
+				c->inlen -= size;
+				memmove(c->inbuf + off, c->inbuf + off + size,
+						c->inlen - off);
+				return 0;
+			}
+			off += size;
+		}
+		if(mmu_event_fill(c, 1) <= 0) return -1;
+		mmu_event_defer(c);
+	}
+}/*}}}*/
+
+void mmu_event_defer(struct mmu_client *c)/*{{{*/
+{
+	if(c->pending) return;
+	c->pending = 1;
+	c->next_pending = mmu->pending;
+	mmu->pending = c;
+}/*}}}*/
+
+static int mmu_ack_index(uint32_t type)/*{{{*/
+{
+	switch(type) {
+	case MMU_PROTO_REMAP_REQ: return 0;
+	case MMU_PROTO_CHPROT_REQ: return 1;
+	case MMU_PROTO_REMAP_BATCH_REQ: return 2;
+	case MMU_PROTO_CHPROT_BATCH_REQ: return 3;
+	default: return -1;
+	}
+}/*}}}*/
+
+static size_t mmu_proto_req_size(uint32_t type)/*{{{*/
+{
+	switch(type) {
+	case MMU_PROTO_CREATE_REQ: return sizeof(struct mmu_proto_create_req);
+	case MMU_PROTO_EXTEND_REQ: return sizeof(struct mmu_proto_extend_req);
+	case MMU_PROTO_SYSLOG_REQ: return sizeof(struct mmu_proto_syslog_req);
+	case MMU_PROTO_SEGV_REQ: return sizeof(struct mmu_proto_segv_req);
+	case MMU_PROTO_EXIT_REQ: return sizeof(struct mmu_proto_exit_req);
+	case MMU_PROTO_RING_REQ: return sizeof(struct mmu_proto_ring_req);
+	default: return sizeof(uint32_t);
+	}
+}/*}}}*/
+
+/* runs every complete request buffered for `c`, the per-client state
+ * machine being simply "waiting for the rest of the next request". */
+static void mmu_event_serve(struct mmu_client *c)/*{{{*/
+{
+	while(mmu->running && c->running && c->inlen >= sizeof(uint32_t)) {
+		uint32_t type;
+		memcpy(&type, c->inbuf, sizeof(type));
+		size_t need = mmu_proto_req_size(type);
+		if(c->inlen < need) break;
+		if(mmu_ack_index(type) != -1) {
+			/* acknowledgements are consumed by whoever waits for
+			 * them; one reaching the loop has no waiter. */
+			mmu_client_log(c, __func__, "dropping stray acknowledgement");
+			c->inlen -= need;
+			memmove(c->inbuf, c->inbuf + need, c->inlen);
+			continue;
+		}
+		if(mmu_client_dispatch(c, type) == -1) {
+			mmu_client_destroy(c);
+			break;
+		}
+	}
+}/*}}}*/
+
+static void mmu_event_accept(void)/*{{{*/
+{
+	for(;;) {
+		int nsock = accept4(mmu->sock, NULL, NULL, SOCK_NONBLOCK);
+		if(nsock == -1) return;
+		if(nsock >= MMU_MAX_SOCK) {
+			logd(LOG_WARN, "%s: sock %d over limit\n", __func__, nsock);
+			close(nsock);
+			continue;
+		}
+		logd(LOG_DEBUG, "%s: sock %d\n", __func__, nsock);
+		struct mmu_client *c = mmu_client_new(nsock);
+		struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+		if(epoll_ctl(mmu->epfd, EPOLL_CTL_ADD, nsock, &ev) == -1)
+			logea(__FILE__, __LINE__, NULL);
+	}
+}/*}}}*/
+
+void mmu_event_loop(void)/*{{{*/
+{
+	mmu->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if(mmu->epfd == -1) logea(__FILE__, __LINE__, NULL);
+	int flags = fcntl(mmu->sock, F_GETFL);
+	if(fcntl(mmu->sock, F_SETFL, flags | O_NONBLOCK) == -1)
+		logea(__FILE__, __LINE__, NULL);
+	struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+	if(epoll_ctl(mmu->epfd, EPOLL_CTL_ADD, mmu->sock, &ev) == -1)
+		logea(__FILE__, __LINE__, NULL);
+
+	struct epoll_event events[MMU_MAX_EVENTS];
+	while(mmu->running) {
+		int n = epoll_wait(mmu->epfd, events, MMU_MAX_EVENTS,
+				MMU_EVENT_TICK_MS);
+		if(n == -1) continue; /* EINTR from SIGINT */
+		for(int i = 0; i < n; ++i) {
+			struct mmu_client *c = events[i].data.ptr;
+			if(!c) {
+				mmu_event_accept();
+				continue;
+			}
+			if(c->closed) continue;
+			if(mmu_event_fill(c, 0) == 0) mmu_client_destroy(c);
+			mmu_event_defer(c);
+		}
+		/* clients are only freed here, once nothing up the stack
+		 * can still hold them. */
+		while(mmu->pending) {
+			struct mmu_client *c = mmu->pending;
+			mmu->pending = c->next_pending;
+			c->pending = 0;
+			if(!c->closed) mmu_event_serve(c);
+			if(c->closed && !c->pending) {
+				mmu_client_finish(c);
+				mmu_client_free(c);
+			}
+		}
+	}
+	logd(LOG_DEBUG, "%s: exiting\n", __func__);
+}/*}}}*/
+/*}}}*/
+
+/****************************************************************************
+ * fault latency histogram {{{
+ ***************************************************************************/
+void mmu_lat_record(const struct timespec *start)/*{{{*/
+{
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	unsigned long long us = (end.tv_sec - start->tv_sec) * 1000000ULL +
+			(end.tv_nsec - start->tv_nsec) / 1000;
+	int b = us ? 64 - __builtin_clzll(us) : 0;
+	if(b >= MMU_LAT_BUCKETS) b = MMU_LAT_BUCKETS - 1;
+	atomic_fetch_add(&mmu->lat[b], 1);
+}/*}}}*/
+
+/* goes to stderr so stdout stays comparable with the expected output;
+ * stdout is flushed first so the two do not interleave mid-line. */
+void mmu_lat_print(void)/*{{{*/
+{
+	fflush(stdout);
+	unsigned long total = 0;
+	for(int b = 0; b < MMU_LAT_BUCKETS; ++b) total += mmu->lat[b];
+	fprintf(stderr, "fault latency: %lu faults\n", total);
+	if(!total) return;
+	unsigned long sum = 0;
+	for(int b = 0; b < MMU_LAT_BUCKETS; ++b) {
+		unsigned long n = mmu->lat[b];
+		if(!n) continue;
+		sum += n;
+		unsigned long lo = b ? 1UL << (b - 1) : 0;
+		fprintf(stderr, "  %8lu-%-8lu us %10lu %6.2f%% %7.2f%%\n",
+				lo, 1UL << b, n, 100.0 * n / total,
+				100.0 * sum / total);
 	}
 }/*}}}*/
 /*}}}*/
@@ -414,10 +1085,16 @@ void mmu_client_destroy(struct mmu_client *c)/*{{{*/
  ***************************************************************************/
 struct mmu_client * mmu_client_search(pid_t pid)/*{{{*/
 {
-	for(int i = 3; i < MMU_MAX_SOCK; ++i) {
-		if(!mmu->sock2client[i]) continue;
-		if(mmu->sock2client[i]->pid == pid) return mmu->sock2client[i];
+	pthread_mutex_lock(&mmu->clients_lock);
+	int mask = mmu->pid2client_cap - 1;
+	for(int i = mmu_pid_hash(pid, mmu->pid2client_cap);
+			mmu->pid2client[i]; i = (i + 1) & mask) {
+		struct mmu_client *c = mmu->pid2client[i];
+		if(c == MMU_CLIENT_REMOVED || c->pid != pid) continue;
+		pthread_mutex_unlock(&mmu->clients_lock);
+		return c;
 	}
+	pthread_mutex_unlock(&mmu->clients_lock);
 	printf("error: pid %d not found.  aborting.\n", (int)pid);
 	logd(LOG_FATAL, "pid %d not found.  aborting.\n", (int)pid);
 	mmu_destroy();
@@ -444,26 +1121,13 @@ void mmu_resident(pid_t pid, void *vaddr, int frame, int prot)/*{{{*/
 	rep.prot = (int32_t)prot;
 	rep.offset = (uint64_t)(PAGESIZE * frame);
 	rep.vaddr = (intptr_t)vaddr;
-	if(send(c->sock, &rep, sizeof(rep), 0) != sizeof(rep))
-		goto out_client;
 
 	/* We need these functions to wait for the application to
 	 * effect the protection change before we return to the
-	 * pager.  This loop is necessary because mmu_client_thread
-	 * is already in the pager and blocked here (so we cannot
-	 * wait on a condition variable to be signaled forward as
-	 * there is no one else to recv the REMAP_REQ message).  An
-	 * alternative approach would be to use two sockets or
-	 * threads. */
-	uint32_t t;
-	do {
-		 if(recv(c->sock, &t, sizeof(t), MSG_PEEK) != sizeof(t))
-			goto out_client;
-	} while(t != MMU_PROTO_REMAP_REQ);
-	struct mmu_proto_remap_req req;
-	if(recv(c->sock, &req, sizeof(req), 0) != sizeof(req))
+	 * pager.  The client's thread reads the acknowledgement
+	 * even while its worker is blocked in the pager. */
+	if(mmu_client_call(c, &rep, sizeof(rep), MMU_PROTO_REMAP_REQ) == -1)
 		goto out_client;
-	assert(req.type == MMU_PROTO_REMAP_REQ);
 	return;
 
 	out_client:
@@ -481,18 +1145,8 @@ void mmu_nonresident(pid_t pid, void *vaddr)/*{{{*/
 	rep.type = MMU_PROTO_CHPROT_REP;
 	rep.prot = PROT_NONE;
 	rep.vaddr = (intptr_t)vaddr;
-	if(send(c->sock, &rep, sizeof(rep), 0) != sizeof(rep))
+	if(mmu_client_call(c, &rep, sizeof(rep), MMU_PROTO_CHPROT_REQ) == -1)
 		goto out_client;
-
-	uint32_t t;
-	do {
-		if(recv(c->sock, &t, sizeof(t), MSG_PEEK) != sizeof(t))
-			goto out_client;
-	} while(t != MMU_PROTO_CHPROT_REQ);
-	struct mmu_proto_chprot_req req;
-	if(recv(c->sock, &req, sizeof(req), 0) != sizeof(req))
-		goto out_client;
-	assert(req.type == MMU_PROTO_CHPROT_REQ);
 	return;
 
 	out_client:
@@ -510,22 +1164,84 @@ void mmu_chprot(pid_t pid, void *vaddr, int prot)/*{{{*/
 	rep.type = MMU_PROTO_CHPROT_REP;
 	rep.prot = (int32_t)prot;
 	rep.vaddr = (intptr_t)vaddr;
-	if(send(c->sock, &rep, sizeof(rep), 0) != sizeof(rep))
+	if(mmu_client_call(c, &rep, sizeof(rep), MMU_PROTO_CHPROT_REQ) == -1)
 		goto out_client;
+	return;
 
-	uint32_t t;
-	do {
-		if(recv(c->sock, &t, sizeof(t), MSG_PEEK) != sizeof(t))
-			goto out_client;
-	} while(t != MMU_PROTO_CHPROT_REQ);
-	struct mmu_proto_chprot_req req;
-	if(recv(c->sock, &req, sizeof(req), 0) != sizeof(req))
+	out_client:
+	mmu_client_destroy(c);
+}/*}}}*/
+
+/* sends one batch of at most MMU_PROTO_BATCH_MAX entries and waits
+ * for the single acknowledgement, like mmu_chprot does for one page.
+ * returns -1 if the client went away (and was hung up). */
+static int mmu_client_batch(struct mmu_client *c, uint32_t type,/*{{{*/
+		uint32_t acktype, const struct mmu_proto_batch_entry *entries,
+		int count)
+{
+	struct mmu_proto_batch_rep rep;
+	rep.type = type;
+	rep.count = (uint32_t)count;
+	size_t esz = count * sizeof(entries[0]);
+	char buf[sizeof(rep) + MMU_PROTO_BATCH_MAX * sizeof(entries[0])];
+	memcpy(buf, &rep, sizeof(rep));
+	memcpy(buf + sizeof(rep), entries, esz);
+	if(mmu_client_call(c, buf, sizeof(rep) + esz, acktype) == -1)
 		goto out_client;
-	assert(req.type == MMU_PROTO_CHPROT_REQ);
-	return;
+	return 0;
 
 	out_client:
 	mmu_client_destroy(c);
+	return -1;
+}/*}}}*/
+
+void mmu_resident_batch(pid_t pid, void **vaddrs, const int *frames,/*{{{*/
+		const int *prots, int count)
+{
+	int id = get_pid_id(pid);
+	struct mmu_client *c = mmu_client_search(pid);
+	struct mmu_proto_batch_entry entries[MMU_PROTO_BATCH_MAX];
+	for(int i = 0; i < count; i += MMU_PROTO_BATCH_MAX) {
+		int n = count - i;
+		if(n > MMU_PROTO_BATCH_MAX) n = MMU_PROTO_BATCH_MAX;
+		for(int j = 0; j < n; ++j) {
+			printf("mmu_resident pid %d vaddr %p prot %d frame %u\n",
+					id, vaddrs[i+j], prots[i+j], frames[i+j]);
+			logd(LOG_DEBUG, "%s pid %d vaddr %p prot %d frame %u\n",
+					__func__, id, vaddrs[i+j], prots[i+j],
+					frames[i+j]);
+			entries[j].prot = (int32_t)prots[i+j];
+			entries[j].offset = (uint64_t)(PAGESIZE * frames[i+j]);
+			entries[j].vaddr = (intptr_t)vaddrs[i+j];
+		}
+		if(mmu_client_batch(c, MMU_PROTO_REMAP_BATCH_REP,
+				MMU_PROTO_REMAP_BATCH_REQ, entries, n) == -1)
+			return;
+	}
+}/*}}}*/
+
+void mmu_chprot_batch(pid_t pid, void **vaddrs, const int *prots,/*{{{*/
+		int count)
+{
+	int id = get_pid_id(pid);
+	struct mmu_client *c = mmu_client_search(pid);
+	struct mmu_proto_batch_entry entries[MMU_PROTO_BATCH_MAX];
+	for(int i = 0; i < count; i += MMU_PROTO_BATCH_MAX) {
+		int n = count - i;
+		if(n > MMU_PROTO_BATCH_MAX) n = MMU_PROTO_BATCH_MAX;
+		for(int j = 0; j < n; ++j) {
+			printf("mmu_chprot pid %d vaddr %p prot %d\n", id,
+					vaddrs[i+j], prots[i+j]);
+			logd(LOG_DEBUG, "%s pid %d vaddr %p prot %d\n",
+					__func__, id, vaddrs[i+j], prots[i+j]);
+			entries[j].prot = (int32_t)prots[i+j];
+			entries[j].offset = 0;
+			entries[j].vaddr = (intptr_t)vaddrs[i+j];
+		}
+		if(mmu_client_batch(c, MMU_PROTO_CHPROT_BATCH_REP,
+				MMU_PROTO_CHPROT_BATCH_REQ, entries, n) == -1)
+			return;
+	}
 }/*}}}*/
 
 void mmu_disk_read(int block_from, int frame_to)/*{{{*/
@@ -556,7 +1272,19 @@ void mmu_disk_write(int frame_from, int block_to)/*{{{*/
 void pager_free(void);
 #endif
 void usage(int argc, char **argv) {/*{{{*/
-	printf("usage: %s NFRAMES NBLOCKS\n", argv[0]);
+	printf("usage: %s [-e] [-c PERCENT] [-l] [-r PAGES] [-p POLICY]\n"
+			"       NFRAMES NBLOCKS\n", argv[0]);
+	printf("\n");
+	printf("  -e  serve all clients from one epoll loop instead of\n");
+	printf("      a thread per client\n");
+	printf("  -c  write dirty pages back from a background thread,\n");
+	printf("      keeping PERCENT%% of the frames free or clean (not\n");
+	printf("      with -e)\n");
+	printf("  -l  print a fault latency histogram to stderr at exit\n");
+	printf("  -r  on sequential faults, also map up to PAGES of the\n");
+	printf("      following pages (1 <= PAGES <= 64)\n");
+	printf("  -p  page replacement policy: second-chance (default),\n");
+	printf("      nru, aging, clock-pro, arc or wsclock\n");
 	printf("\n");
 	printf("valid ranges: 2 <= NFRAMES <= 256\n");
 	printf("              4 <= NBLOCKS <= 1024\n");
@@ -564,18 +1292,49 @@ void usage(int argc, char **argv) {/*{{{*/
 }/*}}}*/
 
 int main(int argc, char **argv) {/*{{{*/
-	if(argc != 3) usage(argc, argv);
-	int npages = atoi(argv[1]);
+	int event = 0;
+	int clean = 0;
+	int lathist = 0;
+	int readahead = 0;
+	int opt;
+	while((opt = getopt(argc, argv, "ec:lr:p:")) != -1) {
+		switch(opt) {
+		case 'e': event = 1; break;
+		case 'c':
+			clean = atoi(optarg);
+			if(clean < 1 || clean > 100) usage(argc, argv);
+			break;
+		case 'l': lathist = 1; break;
+		case 'r':
+			readahead = atoi(optarg);
+			if(readahead < 1 || readahead > 64) usage(argc, argv);
+			break;
+		case 'p':
+			if(pager_policy(optarg) == -1) usage(argc, argv);
+			break;
+		default: usage(argc, argv);
+		}
+	}
+	/* the event loop reads every socket itself, so no other thread
+	 * may wait for acknowledgements */
+	if(event && clean) usage(argc, argv);
+	if(argc - optind != 2) usage(argc, argv);
+	int npages = atoi(argv[optind]);
 	if(npages < 1 || npages > 256) usage(argc, argv);
-	int nblocks = atoi(argv[2]);
+	int nblocks = atoi(argv[optind+1]);
 	if(nblocks < 2 || nblocks > 1024) usage(argc, argv);
 	#ifdef MMULOG
 	log_init(LOG_EXTRA, "mmu.log", 1, 1<<20);
 	#endif
-	memset(id2pid, 255, UINT8_MAX * sizeof(pid_t));
 	mmu_init(npages, nblocks);
 	pager_init(npages, nblocks);
-	mmu_accept_loop();
+	mmu->event = event;
+	mmu->lathist = lathist;
+	if(clean) pager_cleaner_start(clean);
+	if(readahead) pager_readahead(readahead);
+	if(event) mmu_event_loop();
+	else mmu_accept_loop();
+	if(lathist) mmu_lat_print();
 	#ifdef MMUFREE
 	pager_free();
 	#endif
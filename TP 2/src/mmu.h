@@ -49,6 +49,17 @@ void mmu_nonresident(pid_t pid, void *vaddr);
  * on `vaddr` and `prot`.  */
 void mmu_chprot(pid_t pid, void *vaddr, int prot);
 
+/* `mmu_resident_batch` and `mmu_chprot_batch` have the same effect
+ * as calling `mmu_resident` or `mmu_chprot` on each of the `count`
+ * pages of process `pid`, in order, but the process applies the
+ * changes in one round trip per `MMU_PROTO_BATCH_MAX` pages.  Page
+ * `i` is `vaddrs[i]`, with protection `prots[i]` (and frame
+ * `frames[i]` for `mmu_resident_batch`).  */
+void mmu_resident_batch(pid_t pid, void **vaddrs, const int *frames,
+		const int *prots, int count);
+void mmu_chprot_batch(pid_t pid, void **vaddrs, const int *prots,
+		int count);
+
 /* `mmu_disk_read` copies content from disk block `block_from` into
  * physical frame `frame_to`.  `mmu_disk_write` copies content from
  * frame `frame_from` to disk block `block_to`.  Your pager shoudl
@@ -23,7 +23,18 @@
  * The `REMAP` and `CHPROT` messages are generated by the MMU and
  * are processed by `uvm_thread` asynchronously.  These messages are
  * used to service sergmentation faults and whenever the pager pages
- * some of the processes pages to disk. */
+ * some of the processes pages to disk.
+ *
+ * The `REMAP_BATCH` and `CHPROT_BATCH` messages carry up to
+ * `MMU_PROTO_BATCH_MAX` (vaddr, prot, offset) entries after a
+ * fixed header and are acknowledged once.  The client sorts the
+ * entries and coalesces adjacent pages into single `mmap` or
+ * `mprotect` calls.
+ *
+ * A client may send `RING` right after `CREATE` with a `memfd`
+ * attached (SCM_RIGHTS) holding the shared rings from ring.h.  If
+ * the reply carries status 0, every later message in both
+ * directions goes through the rings instead of the socket. */
 
 #ifndef __MMUPROTO_HEADER__
 #define __MMUPROTO_HEADER__
@@ -44,6 +55,12 @@
 #define MMU_PROTO_REMAP_REP 10
 #define MMU_PROTO_CHPROT_REQ 11
 #define MMU_PROTO_CHPROT_REP 12
+#define MMU_PROTO_REMAP_BATCH_REQ 13
+#define MMU_PROTO_REMAP_BATCH_REP 14
+#define MMU_PROTO_CHPROT_BATCH_REQ 15
+#define MMU_PROTO_CHPROT_BATCH_REP 16
+#define MMU_PROTO_RING_REQ 17
+#define MMU_PROTO_RING_REP 18
 #define MMU_PROTO_EXIT_REQ 32
 #define MMU_PROTO_EXIT_REP 33
 
@@ -103,6 +120,32 @@ struct mmu_proto_chprot_rep {
 	uint64_t vaddr;
 } __attribute__((packed));
 
+#define MMU_PROTO_BATCH_MAX 256
+
+struct mmu_proto_batch_entry {
+	int32_t prot;
+	uint64_t offset; /* ignored by CHPROT_BATCH */
+	uint64_t vaddr;
+} __attribute__((packed));
+
+/* `count` entries of `struct mmu_proto_batch_entry` follow the
+ * header on the socket. */
+struct mmu_proto_batch_req {
+	uint32_t type;
+} __attribute__((packed));
+struct mmu_proto_batch_rep {
+	uint32_t type;
+	uint32_t count;
+} __attribute__((packed));
+
+struct mmu_proto_ring_req {
+	uint32_t type;
+} __attribute__((packed));
+struct mmu_proto_ring_rep {
+	uint32_t type;
+	int32_t status;
+} __attribute__((packed));
+
 struct mmu_proto_exit_req {
 	uint32_t type;
 } __attribute__((packed));
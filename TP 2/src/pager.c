@@ -2,6 +2,7 @@
  * DEPARTAMENTO DE CIENCIA DA COMPUTACAO    *
  * Copyright (c) Italo Fernando Scota Cunha */
 
+#define _GNU_SOURCE
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -11,29 +12,61 @@
 
 #include "mmu.h"
 #include "pager.h"
+#include "policy.h"
 
 #define INVALID_PID -1
+// marca de slot liberado por pager_destroy na tabela hash de processos; a busca
+// continua depois dele e pager_create pode reutilizá-lo
+#define REMOVED_PID -2
+// quantidade de páginas em cada folha da tabela radix; cada folha é alocada de uma
+// vez e nunca muda de endereço, então frames_t.page e blocks_t.page continuam válidos
+#define PAGE_LEAF_SIZE 512
+// quantas faltas seguidas com o mesmo passo caracterizam um acesso sequencial
+#define READAHEAD_STREAK 2
+
 typedef struct page_t
 {
 	int isvalid;
 	int frame_number;
 	int block_number;
-	int is_allocated;
+	int is_allocated; // 1 se a página pode ter sido escrita desde a última cópia no disco
+	int busy; // 1 enquanto há mensagem ao processo ou cópia de disco em andamento
+	int prot; // permissão atual no processo, para o limpador saber se precisa tirar a escrita
+	int readahead; // 1 se foi trazida por leitura antecipada e o processo ainda não faltou nela
 	intptr_t addr;
 } page_t;
 
+// tabela radix de dois níveis indexada por (addr - UVM_BASEADDR) / page_size
 typedef struct page_table_t
 {
 	pid_t pid;
-	page_t *pages;
+	pthread_mutex_t *lock; // serializa as operações do processo; alocada à parte porque o rehash copia a entrada
+	page_t **leaves; // diretório: folhas de PAGE_LEAF_SIZE páginas
+	int leaf_capacity;
 	int page_count;
-	int page_capacity;
+	// detecção de acesso sequencial (pager_readahead), protegida por frame_lock:
+	// índice da última página que faltou, passo entre as duas últimas faltas, quantas
+	// faltas seguidas tiveram esse passo, quantas páginas trazer a mais por falta e
+	// quantas posições a última janela cobriu (terminando em ra_last)
+	int ra_last;
+	int ra_stride;
+	int ra_streak;
+	int ra_window;
+	int ra_ahead;
 } page_table_t;
 
+// bitmap de dois níveis para achar o menor índice livre: cada bit de `bits` marca um
+// item livre e cada bit de `summary` marca uma palavra de `bits` com algum bit ligado
+typedef struct bitmap_t
+{
+	int nwords;
+	uint64_t *bits;
+	uint64_t *summary;
+} bitmap_t;
+
 typedef struct frames_t
 {
 	pid_t pid;
-	int reference_bit; // bit de referência utilizado pelo algoritmo da segunda chance
 	page_t *page;
 } frames_t;
 
@@ -41,8 +74,8 @@ typedef struct frame_list_t
 {
 	int size;
 	int page_size;
-	int second_chance_index;
 	frames_t *frames;
+	bitmap_t free_frames;
 } frame_list_t;
 
 typedef struct blocks_t
@@ -55,21 +88,113 @@ typedef struct block_list_t
 {
 	int nblocks;
 	blocks_t *blocks;
+	bitmap_t free_blocks;
 } block_list_t;
 
 frame_list_t frame_list;
 block_list_t block_list;
-page_table_t *page_list;
-int page_tables_count = 0;
-int page_tables_capacity = 10;
-pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+page_table_t *page_list; // tabela hash de endereçamento aberto indexada pelo pid
+int page_tables_count = 0;     // processos vivos na tabela
+int page_tables_used = 0;      // slots não vazios (vivos ou removidos)
+int page_tables_capacity = 16; // sempre potência de 2
+
+// Travas, sempre tomadas nesta ordem: page_list_lock, a trava do processo, frame_lock
+// e block_lock.  Faltas e pager_extend leem page_list_lock; pager_create e
+// pager_destroy a escrevem, então nenhum processo some (nem a tabela hash muda) no
+// meio de uma falta, mesmo que ela esteja despejando a página de outro processo.
+// As leituras ficam presas durante as mensagens ao processo, e com muitos processos
+// sempre há uma em andamento; a trava prefere quem escreve para que pager_create e
+// pager_destroy não esperem até quase todos os outros processos terminarem.
+pthread_rwlock_t page_list_lock = PTHREAD_RWLOCK_WRITER_NONRECURSIVE_INITIALIZER_NP;
+// frame_lock protege frame_list (quadros e bitmap), o estado da política de
+// substituição, os campos de residência das páginas (isvalid, frame_number,
+// is_allocated, busy e readahead) e blocks_t.is_allocated.  Ela nunca fica presa
+// durante chamadas ao MMU: a página em trânsito fica marcada com busy, a política pula
+// o seu quadro e quem precisa dela espera em frame_cond.
+pthread_mutex_t frame_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t frame_cond = PTHREAD_COND_INITIALIZER;
+// block_lock protege block_list.free_blocks e blocks_t.page
+pthread_mutex_t block_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// limpador (pager_cleaner_start): porcentagem dos quadros que ele tenta manter livres
+// ou limpos, ou 0 se desligado; faltas que sujam uma página o acordam por cleaner_cond
+int cleaner_target = 0;
+pthread_cond_t cleaner_cond = PTHREAD_COND_INITIALIZER;
+
+// leitura antecipada (pager_readahead): maior janela por processo, ou 0 se desligada
+int readahead_max = 0;
+
+// despejo de um quadro: preparado sob frame_lock por swap_prepare, executado sem
+// nenhuma trava por swap_io e encerrado por swap_finish
+typedef struct eviction_t
+{
+	int frame_no;
+	pid_t pid;
+	page_t *page;
+	int write_back;
+	int sweep_count; // páginas que perdem a permissão na varredura pedida pela política
+	pid_t *sweep_pids;
+	page_t **sweep_pages;
+} eviction_t;
+
+// Função auxiliar para criar um bitmap com os itens 0..size-1 livres
+void bitmap_init(bitmap_t *bitmap, int size)
+{
+	bitmap->nwords = (size + 63) / 64;
+	int nsummary = (bitmap->nwords + 63) / 64;
+	bitmap->bits = calloc(bitmap->nwords, sizeof(uint64_t));
+	bitmap->summary = calloc(nsummary, sizeof(uint64_t));
+
+	for (int i = 0; i < size; i++)
+		bitmap->bits[i / 64] |= 1ULL << (i % 64);
+	for (int w = 0; w < bitmap->nwords; w++)
+		if (bitmap->bits[w] != 0)
+			bitmap->summary[w / 64] |= 1ULL << (w % 64);
+}
+
+// Função auxiliar para marcar um item como livre
+void bitmap_set_free(bitmap_t *bitmap, int index)
+{
+	int w = index / 64;
+	bitmap->bits[w] |= 1ULL << (index % 64);
+	bitmap->summary[w / 64] |= 1ULL << (w % 64);
+}
+
+// Função auxiliar para marcar um item como ocupado
+void bitmap_set_used(bitmap_t *bitmap, int index)
+{
+	int w = index / 64;
+	bitmap->bits[w] &= ~(1ULL << (index % 64));
+	if (bitmap->bits[w] == 0)
+		bitmap->summary[w / 64] &= ~(1ULL << (w % 64));
+}
+
+// Função auxiliar para obter o menor item livre: o sumário aponta a primeira palavra
+// não vazia e __builtin_ctzll acha o primeiro bit dentro dela
+int bitmap_first_free(bitmap_t *bitmap)
+{
+	int nsummary = (bitmap->nwords + 63) / 64;
+
+	for (int s = 0; s < nsummary; s++)
+	{
+		if (bitmap->summary[s] == 0)
+			continue;
+
+		int w = s * 64 + __builtin_ctzll(bitmap->summary[s]);
+		return w * 64 + __builtin_ctzll(bitmap->bits[w]);
+	}
+
+	return INVALID_PID;
+}
 
 // Função auxiliar para liberar memória alocada para uma página
 void free_page(page_t *page)
 {
 	if (page->isvalid == 1)
 	{
+		policy->on_free(page->frame_number, 0);
 		frame_list.frames[page->frame_number].pid = INVALID_PID;
+		bitmap_set_free(&frame_list.free_frames, page->frame_number);
 	}
 }
 
@@ -78,96 +203,218 @@ void free_page_list(page_table_t *page_table_list)
 {
 	while (page_table_list->page_count > 0)
 	{
-		page_t *page = &page_table_list->pages[--page_table_list->page_count];
+		int index = --page_table_list->page_count;
+		page_t *page = &page_table_list->leaves[index / PAGE_LEAF_SIZE][index % PAGE_LEAF_SIZE];
 		block_list.blocks[page->block_number].page = NULL;
+		bitmap_set_free(&block_list.free_blocks, page->block_number);
 		free_page(page);
 	}
-	free(page_table_list->pages);
+
+	for (int i = 0; i < page_table_list->leaf_capacity; i++)
+		free(page_table_list->leaves[i]);
+	free(page_table_list->leaves);
+	page_table_list->leaves = NULL;
+	page_table_list->leaf_capacity = 0;
 }
 
-// Função auxiliar para obter um novo frame
+// Função auxiliar para obter um novo frame (o de menor número entre os livres)
 int find_free_frame()
 {
-	for (int i = 0; i < frame_list.size; i++)
-		if (frame_list.frames[i].pid == INVALID_PID)
-			return i;
-
-	return INVALID_PID;
+	return bitmap_first_free(&frame_list.free_frames);
 }
 
 // funçao auxiliar para obter um novo bloco
 int find_free_block()
 {
-	for (int i = 0; i < block_list.nblocks; i++)
-		if (block_list.blocks[i].page == NULL)
-			return i;
+	return bitmap_first_free(&block_list.free_blocks);
+}
 
-	return INVALID_PID;
+// Função auxiliar para obter o slot inicial de um pid na tabela hash (hash multiplicativo)
+int pid_hash(pid_t pid, int capacity)
+{
+	return (int)(((uint32_t)pid * 2654435761u) & (uint32_t)(capacity - 1));
 }
 
-// Função auxiliar para encontrar uma tabela de páginas
-page_table_t *find_page_table(pid_t pid)
+// Função auxiliar para buscar uma tabela de páginas: sondagem linear a partir do hash
+page_table_t *lookup_page_table(pid_t pid)
 {
-	for (int i = 0; i < page_tables_count; i++)
+	int mask = page_tables_capacity - 1;
+
+	for (int i = pid_hash(pid, page_tables_capacity);; i = (i + 1) & mask)
+	{
 		if (page_list[i].pid == pid)
 			return &page_list[i];
-
-	exit(INVALID_PID);
+		if (page_list[i].pid == INVALID_PID)
+			return NULL;
+	}
 }
 
-// Função auxiliar para encontrar uma página
-page_t *get_page(page_table_t *page_table_list, intptr_t addr)
+// Função auxiliar para encontrar uma tabela de páginas
+page_table_t *find_page_table(pid_t pid)
 {
-	for (int i = 0; i < page_table_list->page_count; i++)
-		if (addr >= page_table_list->pages[i].addr && addr < (page_table_list->pages[i].addr + frame_list.page_size))
-			return &page_table_list->pages[i];
+	page_table_t *page_table_list = lookup_page_table(pid);
 
-	return NULL;
+	if (page_table_list == NULL)
+		exit(INVALID_PID);
+
+	return page_table_list;
 }
 
-// Função do algoritmo de segunda chance
-int find_frame_to_swap()
+// Função auxiliar para reconstruir a tabela hash, descartando os slots removidos;
+// as folhas das tabelas de páginas não mudam de lugar, só as entradas são copiadas
+void rehash_page_list(int capacity)
 {
-	frames_t *frames = frame_list.frames;
-	int frame_to_swap = INVALID_PID;
+	page_table_t *old = page_list;
+	int old_capacity = page_tables_capacity;
 
-	while (frame_to_swap == INVALID_PID)
-	{
-		int index = frame_list.second_chance_index;
+	page_list = malloc(capacity * sizeof(page_table_t));
+	for (int i = 0; i < capacity; i++)
+		page_list[i].pid = INVALID_PID;
 
-		if (frames[index].reference_bit == 0)
-			frame_to_swap = index;
-		else
-			frames[index].reference_bit = 0;
+	for (int i = 0; i < old_capacity; i++)
+	{
+		if (old[i].pid == INVALID_PID || old[i].pid == REMOVED_PID)
+			continue;
 
-		frame_list.second_chance_index = (index + 1) % frame_list.size;
+		int j = pid_hash(old[i].pid, capacity);
+		while (page_list[j].pid != INVALID_PID)
+			j = (j + 1) & (capacity - 1);
+		page_list[j] = old[i];
 	}
 
-	return frame_to_swap;
+	free(old);
+	page_tables_capacity = capacity;
+	page_tables_used = page_tables_count;
 }
 
-// Função auxiliar para trocar uma página
-void swap(int frame_no)
+// Função auxiliar para encontrar uma página: acesso direto à tabela radix
+page_t *get_page(page_table_t *page_table_list, intptr_t addr)
+{
+	if (addr < UVM_BASEADDR)
+		return NULL;
+
+	intptr_t index = (addr - UVM_BASEADDR) / frame_list.page_size;
+	if (index >= page_table_list->page_count)
+		return NULL;
+
+	return &page_table_list->leaves[index / PAGE_LEAF_SIZE][index % PAGE_LEAF_SIZE];
+}
+
+// Função auxiliar para a política de substituição consultar um quadro ocupado
+int frame_state(int frame_no)
+{
+	page_t *page = frame_list.frames[frame_no].page;
+	return (page->busy ? POLICY_BUSY : 0) | (page->is_allocated == 1 ? POLICY_DIRTY : 0);
+}
+
+// Função auxiliar para escolher a vítima pela política de substituição (policy.c);
+// quadros com página em trânsito são pulados, e se só sobrarem esses, retorna
+// INVALID_PID.  `sweep` diz se todas as páginas devem perder a permissão.
+int find_frame_to_swap(int *sweep)
 {
-	if (frame_no == 0)
+	*sweep = 0;
+	return policy->pick_victim(sweep);
+}
+
+// Função auxiliar para ajustar a janela de leitura antecipada do processo: um acerto
+// (página trazida antes da hora que o processo usou) a aumenta em uma página, e uma
+// página despejada sem uso a corta pela metade (com frame_lock)
+void readahead_account(page_table_t *page_table_list, page_t *page, int hit)
+{
+	page->readahead = 0;
+	if (page_table_list == NULL)
+		return;
+
+	if (hit && page_table_list->ra_window < readahead_max)
+		page_table_list->ra_window++;
+	else if (!hit && page_table_list->ra_window > 1)
+		page_table_list->ra_window /= 2;
+}
+
+// Função auxiliar para escolher o que a troca de uma página vai fazer (com frame_lock)
+void swap_prepare(eviction_t *ev, int frame_no, int sweep)
+{
+	frames_t *frame = &frame_list.frames[frame_no];
+	ev->frame_no = frame_no;
+	ev->pid = frame->pid;
+	ev->page = frame->page;
+	ev->sweep_count = 0;
+	ev->sweep_pids = NULL;
+	ev->sweep_pages = NULL;
+
+	// quando a política pede (na segunda chance, ao voltar ao quadro 0) todas as
+	// páginas perdem a permissão, menos as que outra falta já tem em trânsito
+	if (sweep)
 	{
+		ev->sweep_pids = malloc(frame_list.size * sizeof(pid_t));
+		ev->sweep_pages = malloc(frame_list.size * sizeof(page_t *));
+
 		for (int i = 0; i < frame_list.size; i++)
 		{
 			page_t *page = frame_list.frames[i].page;
-			mmu_chprot(frame_list.frames[i].pid, (void *)page->addr, PROT_NONE);
+			if (page->busy)
+				continue;
+			page->busy = 1;
+			page->prot = PROT_NONE;
+			ev->sweep_pids[ev->sweep_count] = frame_list.frames[i].pid;
+			ev->sweep_pages[ev->sweep_count++] = page;
 		}
 	}
 
-	frames_t *frame = &frame_list.frames[frame_no];
-	page_t *removed_page = frame->page;
-	removed_page->isvalid = 0;
-	mmu_nonresident(frame->pid, (void *)removed_page->addr);
+	policy->on_free(frame_no, 1);
+
+	// página trazida pela leitura antecipada e despejada sem uso: a janela diminui
+	if (ev->page->readahead)
+		readahead_account(lookup_page_table(ev->pid), ev->page, 0);
+
+	ev->page->isvalid = 0;
+	ev->page->busy = 1;
+	ev->write_back = ev->page->is_allocated == 1;
+	if (ev->write_back)
+		block_list.blocks[ev->page->block_number].is_allocated = 1;
+}
 
-	if (removed_page->is_allocated == 1)
+// Função auxiliar para trocar uma página (sem travas); páginas seguidas do mesmo
+// processo vão numa única mensagem, mantendo a ordem dos quadros
+void swap_io(eviction_t *ev)
+{
+	if (ev->sweep_count > 0)
 	{
-		block_list.blocks[removed_page->block_number].is_allocated = 1;
-		mmu_disk_write(frame_no, removed_page->block_number);
+		void **vaddrs = malloc(ev->sweep_count * sizeof(void *));
+		int *prots = malloc(ev->sweep_count * sizeof(int));
+		int count = 0;
+
+		for (int i = 0; i < ev->sweep_count; i++)
+		{
+			if (count > 0 && ev->sweep_pids[i] != ev->sweep_pids[i - 1])
+			{
+				mmu_chprot_batch(ev->sweep_pids[i - 1], vaddrs, prots, count);
+				count = 0;
+			}
+			vaddrs[count] = (void *)ev->sweep_pages[i]->addr;
+			prots[count++] = PROT_NONE;
+		}
+		mmu_chprot_batch(ev->sweep_pids[ev->sweep_count - 1], vaddrs, prots, count);
+
+		free(vaddrs);
+		free(prots);
 	}
+
+	mmu_nonresident(ev->pid, (void *)ev->page->addr);
+
+	if (ev->write_back)
+		mmu_disk_write(ev->frame_no, ev->page->block_number);
+}
+
+// Função auxiliar para liberar as páginas de uma troca já feita (com frame_lock)
+void swap_finish(eviction_t *ev)
+{
+	for (int i = 0; i < ev->sweep_count; i++)
+		ev->sweep_pages[i]->busy = 0;
+	ev->page->busy = 0;
+
+	free(ev->sweep_pids);
+	free(ev->sweep_pages);
 }
 
 // Função auxiliar para imprimir os bytes de uma página
@@ -193,53 +440,281 @@ void print_page_bytes(page_t *page, size_t len)
 	free(buf);
 }
 
-// Função auxiliar para a lógica do pager_fault após verificar a validade da página
-void handle_valid_page(page_t *page, pid_t pid, void *addr)
+// Função auxiliar para a detecção de acesso sequencial: registra a falta em `page` e, se
+// as últimas faltas do processo mantiveram o mesmo passo, coloca em `out` as próximas
+// páginas não residentes nessa direção, até o tamanho da janela (com frame_lock)
+int readahead_collect(page_table_t *page_table_list, page_t *page, page_t **out)
 {
-	mmu_chprot(pid, addr, PROT_READ | PROT_WRITE);
-	frame_list.frames[page->frame_number].reference_bit = 1;
+	int index = (page->addr - UVM_BASEADDR) / frame_list.page_size;
+	int stride = index - page_table_list->ra_last;
+
+	// um processo que só lê as páginas trazidas não falta nelas: se a falta veio no fim
+	// da última janela ou depois dele, as páginas ainda marcadas foram usadas
+	if (page_table_list->ra_ahead > 0 && stride * page_table_list->ra_stride > 0)
+	{
+		for (int i = 0; i < page_table_list->ra_ahead; i++)
+		{
+			int prev = page_table_list->ra_last - i * page_table_list->ra_stride;
+			page_t *used = &page_table_list->leaves[prev / PAGE_LEAF_SIZE][prev % PAGE_LEAF_SIZE];
+			if (used->readahead)
+				readahead_account(page_table_list, used, 1);
+		}
+	}
+	page_table_list->ra_ahead = 0;
+
+	if (page_table_list->ra_last < 0 || stride == 0)
+		page_table_list->ra_streak = 0;
+	else if (stride == page_table_list->ra_stride)
+		page_table_list->ra_streak++;
+	else
+	{
+		page_table_list->ra_stride = stride;
+		page_table_list->ra_streak = 1;
+	}
+	page_table_list->ra_last = index;
+
+	if (page_table_list->ra_streak < READAHEAD_STREAK)
+		return 0;
+
+	// a próxima falta do fluxo deve vir depois da última página da janela, mesmo que o
+	// processo só leia as páginas trazidas e não falte nelas
+	int count = 0;
+	for (int i = 1; i <= page_table_list->ra_window; i++)
+	{
+		int next = index + i * stride;
+		if (next < 0 || next >= page_table_list->page_count)
+			break;
+		page_table_list->ra_last = next;
+		page_table_list->ra_ahead = i;
+
+		page_t *ahead = &page_table_list->leaves[next / PAGE_LEAF_SIZE][next % PAGE_LEAF_SIZE];
+		if (ahead->isvalid || ahead->busy)
+			continue;
+		out[count++] = ahead;
+	}
+
+	return count;
+}
+
+// Função auxiliar para a lógica do pager_fault após verificar a validade da página;
+// chamada e retorna com frame_lock, que é solta durante a mensagem ao processo
+void handle_valid_page(page_table_t *page_table_list, page_t *page, pid_t pid, void *addr)
+{
+	policy->on_access(page->frame_number);
 	page->is_allocated = 1;
+	page->prot = PROT_READ | PROT_WRITE;
+	page->busy = 1;
+	if (page->readahead)
+		readahead_account(page_table_list, page, 1);
+	if (cleaner_target > 0)
+		pthread_cond_signal(&cleaner_cond);
+	pthread_mutex_unlock(&frame_lock);
+
+	mmu_chprot(pid, addr, PROT_READ | PROT_WRITE);
+
+	pthread_mutex_lock(&frame_lock);
+	page->busy = 0;
+	pthread_cond_broadcast(&frame_cond);
 }
 
-// Função auxiliar para a lógica do pager_fault após verificar a invalidade da página
-void handle_invalid_page(page_t *page, pid_t pid, void *addr)
+// Função auxiliar para a lógica do pager_fault após verificar a invalidade da página;
+// chamada e retorna com frame_lock, que é solta durante a troca, a cópia e a mensagem.
+// Com a leitura antecipada ligada, as páginas seguintes de um fluxo detectado são
+// trazidas junto e mapeadas na mesma mensagem ao processo.
+void handle_invalid_page(page_table_t *page_table_list, page_t *page, pid_t pid, void *addr)
 {
-	int frame_no = find_free_frame();
+	page_t *pages[1 + readahead_max];
+	eviction_t ev[1 + readahead_max];
+	int evicted[1 + readahead_max];
+	int from_disk[1 + readahead_max];
+	int count = 1;
+
+	pages[0] = page;
+	if (readahead_max > 0)
+		count += readahead_collect(page_table_list, page, pages + 1);
 
-	if (frame_no == INVALID_PID)
+	for (int i = 0; i < count; i++)
 	{
-		frame_no = find_frame_to_swap();
-		swap(frame_no);
+		int frame_no;
+		int sweep;
+		evicted[i] = 0;
+		while ((frame_no = find_free_frame()) == INVALID_PID)
+		{
+			frame_no = find_frame_to_swap(&sweep);
+			if (frame_no != INVALID_PID)
+			{
+				swap_prepare(&ev[i], frame_no, sweep);
+				evicted[i] = 1;
+				break;
+			}
+			// só a página que faltou espera; a leitura antecipada para por aqui
+			if (i > 0)
+				break;
+			// todos os quadros estão em trânsito; espera algum ser liberado
+			pthread_cond_wait(&frame_cond, &frame_lock);
+		}
+		if (frame_no == INVALID_PID)
+		{
+			count = i;
+			break;
+		}
+
+		frames_t *frame = &frame_list.frames[frame_no];
+		frame->pid = pid;
+		frame->page = pages[i];
+		bitmap_set_used(&frame_list.free_frames, frame_no);
+		// páginas trazidas antes da hora não contam como usadas para a política
+		policy->on_fault(frame_no, POLICY_KEY(pid, (pages[i]->addr - UVM_BASEADDR) / frame_list.page_size), i > 0);
+
+		pages[i]->isvalid = 1;
+		pages[i]->frame_number = frame_no;
+		pages[i]->is_allocated = 0;
+		pages[i]->prot = PROT_READ;
+		pages[i]->busy = 1;
+		pages[i]->readahead = i > 0;
+		from_disk[i] = block_list.blocks[pages[i]->block_number].is_allocated == 1;
 	}
+	pthread_mutex_unlock(&frame_lock);
 
-	frames_t *frame = &frame_list.frames[frame_no];
-	frame->pid = pid;
-	frame->page = page;
-	frame->reference_bit = 1;
+	for (int i = 0; i < count; i++)
+	{
+		if (evicted[i])
+			swap_io(&ev[i]);
 
-	page->isvalid = 1;
-	page->frame_number = frame_no;
-	page->is_allocated = 0;
+		if (from_disk[i])
+			mmu_disk_read(pages[i]->block_number, pages[i]->frame_number);
+		else
+			mmu_zero_fill(pages[i]->frame_number);
+	}
 
-	if (block_list.blocks[page->block_number].is_allocated == 1)
-		mmu_disk_read(page->block_number, frame_no);
+	if (count == 1)
+		mmu_resident(pid, addr, page->frame_number, PROT_READ);
 	else
-		mmu_zero_fill(frame_no);
+	{
+		void *vaddrs[count];
+		int frames[count];
+		int prots[count];
+		for (int i = 0; i < count; i++)
+		{
+			vaddrs[i] = (void *)pages[i]->addr;
+			frames[i] = pages[i]->frame_number;
+			prots[i] = PROT_READ;
+		}
+		mmu_resident_batch(pid, vaddrs, frames, prots, count);
+	}
 
-	mmu_resident(pid, addr, frame_no, PROT_READ);
+	pthread_mutex_lock(&frame_lock);
+	for (int i = 0; i < count; i++)
+	{
+		if (evicted[i])
+			swap_finish(&ev[i]);
+		pages[i]->busy = 0;
+	}
+	pthread_cond_broadcast(&frame_cond);
 }
 
 // Função auxiliar para verificar a validade da página antes de lidar com o pager_fault
 void check_page_validity(pid_t pid, void *addr)
 {
 	page_table_t *page_table_list = find_page_table(pid);
+	pthread_mutex_lock(page_table_list->lock);
 	addr = (void *)((intptr_t)addr - (intptr_t)addr % frame_list.page_size);
 	page_t *page = get_page(page_table_list, (intptr_t)addr);
 
+	// a página pode estar sendo despejada pela falta de outro processo
+	pthread_mutex_lock(&frame_lock);
+	while (page->busy)
+		pthread_cond_wait(&frame_cond, &frame_lock);
+
 	if (page->isvalid == 1)
-		handle_valid_page(page, pid, addr);
+		handle_valid_page(page_table_list, page, pid, addr);
 	else
-		handle_invalid_page(page, pid, addr);
+		handle_invalid_page(page_table_list, page, pid, addr);
+
+	pthread_mutex_unlock(&frame_lock);
+	pthread_mutex_unlock(page_table_list->lock);
+}
+
+// Função auxiliar para contar os quadros que uma falta pode usar sem escrever no disco
+int count_clean_frames()
+{
+	int clean = 0;
+
+	for (int i = 0; i < frame_list.size; i++)
+	{
+		frames_t *frame = &frame_list.frames[i];
+		if (frame->pid == INVALID_PID || (!frame->page->busy && frame->page->is_allocated == 0))
+			clean++;
+	}
+
+	return clean;
+}
+
+// Função auxiliar para achar a primeira página suja a partir de onde a política vai
+// procurar a próxima vítima, que é mais ou menos a ordem em que ela vai alcançá-las
+int find_frame_to_clean()
+{
+	int hand = policy->hand();
+
+	for (int step = 0; step < frame_list.size; step++)
+	{
+		int index = (hand + step) % frame_list.size;
+		frames_t *frame = &frame_list.frames[index];
+
+		if (frame->pid != INVALID_PID && !frame->page->busy && frame->page->is_allocated == 1)
+			return index;
+	}
+
+	return INVALID_PID;
+}
+
+// Thread do limpador: enquanto houver menos quadros livres ou limpos que o alvo, tira a
+// escrita da próxima página suja, copia a página para o disco e a marca como limpa.  A
+// página fica em trânsito durante a cópia, então as faltas escolhem outro quadro.
+void *cleaner_thread(void *arg)
+{
+	for (;;)
+	{
+		pthread_rwlock_rdlock(&page_list_lock);
+		pthread_mutex_lock(&frame_lock);
+
+		int frame_no = INVALID_PID;
+		if (count_clean_frames() * 100 < cleaner_target * frame_list.size)
+			frame_no = find_frame_to_clean();
+
+		if (frame_no == INVALID_PID)
+		{
+			// sem page_list_lock enquanto dorme, para não segurar pager_create
+			pthread_rwlock_unlock(&page_list_lock);
+			pthread_cond_wait(&cleaner_cond, &frame_lock);
+			pthread_mutex_unlock(&frame_lock);
+			continue;
+		}
+
+		frames_t *frame = &frame_list.frames[frame_no];
+		page_t *page = frame->page;
+		pid_t pid = frame->pid;
+		int write_protect = page->prot == (PROT_READ | PROT_WRITE);
+		page->busy = 1;
+		if (write_protect)
+			page->prot = PROT_READ;
+		pthread_mutex_unlock(&frame_lock);
+
+		// depois da confirmação o processo não escreve mais sem passar por pager_fault
+		if (write_protect)
+			mmu_chprot(pid, (void *)page->addr, PROT_READ);
+		mmu_disk_write(frame_no, page->block_number);
+
+		pthread_mutex_lock(&frame_lock);
+		page->is_allocated = 0;
+		block_list.blocks[page->block_number].is_allocated = 1;
+		page->busy = 0;
+		pthread_cond_broadcast(&frame_cond);
+		pthread_mutex_unlock(&frame_lock);
+		pthread_rwlock_unlock(&page_list_lock);
+	}
+
+	return NULL;
 }
 
 /* `pager_init` is called by the memory management infrastructure to
@@ -248,42 +723,78 @@ void check_page_validity(pid_t pid, void *addr)
  * backing store, respectively. */
 void pager_init(int nframes, int nblocks)
 {
-	pthread_mutex_lock(&mutex);
+	pthread_rwlock_wrlock(&page_list_lock);
 	frame_list.size = nframes;
 	frame_list.page_size = sysconf(_SC_PAGESIZE);
-	frame_list.second_chance_index = 0;
 
 	frame_list.frames = malloc(nframes * sizeof(frames_t));
 	for (int i = 0; i < nframes; i++)
 		frame_list.frames[i].pid = INVALID_PID;
+	bitmap_init(&frame_list.free_frames, nframes);
+	policy_init(nframes, frame_state);
 
 	block_list.nblocks = nblocks;
 	block_list.blocks = malloc(nblocks * sizeof(blocks_t));
 	for (int i = 0; i < nblocks; i++)
+	{
 		block_list.blocks[i].is_allocated = 0;
+		block_list.blocks[i].page = NULL;
+	}
+	bitmap_init(&block_list.free_blocks, nblocks);
 
 	page_list = malloc(page_tables_capacity * sizeof(page_table_t));
-	pthread_mutex_unlock(&mutex);
+	for (int i = 0; i < page_tables_capacity; i++)
+		page_list[i].pid = INVALID_PID;
+	pthread_rwlock_unlock(&page_list_lock);
 }
 
 /* `pager_create` should initialize any resources the pager needs to
  * manage memory for a new process `pid`. */
 void pager_create(pid_t pid)
 {
-	pthread_mutex_lock(&mutex);
-	if (page_tables_count == page_tables_capacity)
+	pthread_rwlock_wrlock(&page_list_lock);
+	// mantém a ocupação (vivos + removidos) abaixo de 3/4; se a maior parte for de
+	// slots removidos, reconstrói com o mesmo tamanho em vez de crescer
+	if ((page_tables_used + 1) * 4 > page_tables_capacity * 3)
 	{
-		page_tables_capacity *= 2;
-		page_list = realloc(page_list, page_tables_capacity * sizeof(page_table_t));
+		int capacity = page_tables_capacity;
+		if ((page_tables_count + 1) * 2 > capacity)
+			capacity *= 2;
+		rehash_page_list(capacity);
 	}
 
-	page_table_t *page_table_list = &page_list[page_tables_count++];
+	int mask = page_tables_capacity - 1;
+	int slot = -1;
+	for (int i = pid_hash(pid, page_tables_capacity);; i = (i + 1) & mask)
+	{
+		if (page_list[i].pid == REMOVED_PID && slot == -1)
+			slot = i;
+		if (page_list[i].pid == INVALID_PID)
+		{
+			if (slot == -1)
+			{
+				slot = i;
+				page_tables_used++;
+			}
+			break;
+		}
+	}
+
+	page_table_t *page_table_list = &page_list[slot];
+	page_tables_count++;
 	page_table_list->pid = pid;
-	page_table_list->pages = malloc(0);
+	page_table_list->lock = malloc(sizeof(pthread_mutex_t));
+	pthread_mutex_init(page_table_list->lock, NULL);
+	page_table_list->leaves = NULL;
+	page_table_list->leaf_capacity = 0;
 	page_table_list->page_count = 0;
-	page_table_list->page_capacity = 0;
+	page_table_list->ra_last = -1;
+	page_table_list->ra_stride = 0;
+	page_table_list->ra_streak = 0;
+	page_table_list->ra_window = 1;
+	page_table_list->ra_ahead = 0;
 
-	pthread_mutex_unlock(&mutex);
+	pthread_rwlock_unlock(&page_list_lock);
 }
 
 /* `pager_extend` allocates a new page of memory to process `pid`
@@ -295,31 +806,55 @@ void pager_create(pid_t pid)
  * use as backing storage. */
 void *pager_extend(pid_t pid)
 {
-	pthread_mutex_lock(&mutex);
+	pthread_rwlock_rdlock(&page_list_lock);
+	page_table_t *page_table_list = find_page_table(pid);
+	pthread_mutex_lock(page_table_list->lock);
+
+	pthread_mutex_lock(&block_lock);
 	int block_no = find_free_block();
 
 	if (block_no == INVALID_PID)
 	{
-		pthread_mutex_unlock(&mutex);
+		pthread_mutex_unlock(&block_lock);
+		pthread_mutex_unlock(page_table_list->lock);
+		pthread_rwlock_unlock(&page_list_lock);
 		return NULL;
 	}
+	bitmap_set_used(&block_list.free_blocks, block_no);
+	pthread_mutex_unlock(&block_lock);
 
-	page_table_t *page_table_list = find_page_table(pid);
+	int index = page_table_list->page_count;
+	int leaf = index / PAGE_LEAF_SIZE;
 
-	if (page_table_list->page_count == page_table_list->page_capacity)
+	// só o diretório é realocado; as folhas já existentes não mudam de lugar
+	if (leaf == page_table_list->leaf_capacity)
 	{
-		page_table_list->page_capacity = page_table_list->page_capacity == 0 ? 1 : page_table_list->page_capacity * 2;
-		page_table_list->pages = realloc(page_table_list->pages, page_table_list->page_capacity * sizeof(page_t));
+		int capacity = page_table_list->leaf_capacity == 0 ? 1 : page_table_list->leaf_capacity * 2;
+		page_table_list->leaves = realloc(page_table_list->leaves, capacity * sizeof(page_t *));
+		for (int i = page_table_list->leaf_capacity; i < capacity; i++)
+			page_table_list->leaves[i] = NULL;
+		page_table_list->leaf_capacity = capacity;
 	}
+	if (page_table_list->leaves[leaf] == NULL)
+		page_table_list->leaves[leaf] = malloc(PAGE_LEAF_SIZE * sizeof(page_t));
 
-	page_t *page = &page_table_list->pages[page_table_list->page_count++];
+	page_t *page = &page_table_list->leaves[leaf][index % PAGE_LEAF_SIZE];
+	page_table_list->page_count++;
 	page->isvalid = 0;
+	page->frame_number = INVALID_PID;
+	page->is_allocated = 0;
+	page->busy = 0;
+	page->prot = PROT_NONE;
+	page->readahead = 0;
 	page->addr = UVM_BASEADDR + (page_table_list->page_count - 1) * frame_list.page_size;
 	page->block_number = block_no;
 
+	pthread_mutex_lock(&block_lock);
 	block_list.blocks[block_no].page = page;
+	pthread_mutex_unlock(&block_lock);
 
-	pthread_mutex_unlock(&mutex);
+	pthread_mutex_unlock(page_table_list->lock);
+	pthread_rwlock_unlock(&page_list_lock);
 	return (void *)page->addr;
 }
 
@@ -337,9 +872,9 @@ void *pager_extend(pid_t pid)
  * to implement the second-chance algorithm. */
 void pager_fault(pid_t pid, void *addr)
 {
-	pthread_mutex_lock(&mutex);
+	pthread_rwlock_rdlock(&page_list_lock);
 	check_page_validity(pid, addr);
-	pthread_mutex_unlock(&mutex);
+	pthread_rwlock_unlock(&page_list_lock);
 }
 
 /* `pager_syslog prints a message made of `len` bytes following
@@ -351,27 +886,39 @@ void pager_fault(pid_t pid, void *addr)
  * the syslog succeeds, it should return 0. */
 int pager_syslog(pid_t pid, void *addr, size_t len)
 {
-	pthread_mutex_lock(&mutex);
+	pthread_rwlock_rdlock(&page_list_lock);
 	page_table_t *page_table_list = find_page_table(pid);
-	char *buf = (char *)malloc(len + 1);
-	page_t *page;
-
-	for (size_t i = 0, m = 0; i < len; i++)
+	pthread_mutex_lock(page_table_list->lock);
+	pthread_mutex_lock(&frame_lock);
+	page_t *page = NULL;
+
+	// lê como o processo leria: cada página do intervalo é trazida para a memória pelo
+	// mesmo caminho de uma falta, e a que está em trânsito é esperada
+	intptr_t first = (intptr_t)addr - (intptr_t)addr % frame_list.page_size;
+	for (intptr_t vaddr = first; vaddr < (intptr_t)addr + (intptr_t)len; vaddr += frame_list.page_size)
 	{
-		page = get_page(page_table_list, (intptr_t)addr + i);
+		page = get_page(page_table_list, vaddr);
 		if (page == NULL)
 		{
-			free(buf);
-			pthread_mutex_unlock(&mutex);
+			pthread_mutex_unlock(&frame_lock);
+			pthread_mutex_unlock(page_table_list->lock);
+			pthread_rwlock_unlock(&page_list_lock);
 			return INVALID_PID;
 		}
-		buf[m++] = pmem[page->frame_number * frame_list.page_size + i];
+
+		while (page->busy)
+			pthread_cond_wait(&frame_cond, &frame_lock);
+		if (page->isvalid == 0)
+			handle_invalid_page(page_table_list, page, pid, (void *)page->addr);
 	}
 
-	print_page_bytes(page, len);
+	// a última página continua residente: frame_lock não foi solta desde que ela chegou
+	if (page != NULL)
+		print_page_bytes(page, len);
 
-	free(buf);
-	pthread_mutex_unlock(&mutex);
+	pthread_mutex_unlock(&frame_lock);
+	pthread_mutex_unlock(page_table_list->lock);
+	pthread_rwlock_unlock(&page_list_lock);
 	return 0;
 }
 
@@ -381,8 +928,55 @@ int pager_syslog(pid_t pid, void *addr, size_t len)
  * functions. */
 void pager_destroy(pid_t pid)
 {
-	pthread_mutex_lock(&mutex);
-	page_table_t *page_table_list = find_page_table(pid);
+	// com page_list_lock para escrita nenhuma outra operação do paginador está em
+	// andamento, então os quadros e blocos podem ser liberados sem as outras travas
+	pthread_rwlock_wrlock(&page_list_lock);
+	// um cliente pode ser destruído duas vezes (saída e erro no socket)
+	page_table_t *page_table_list = lookup_page_table(pid);
+	if (page_table_list == NULL)
+	{
+		pthread_rwlock_unlock(&page_list_lock);
+		return;
+	}
+
 	free_page_list(page_table_list);
-	pthread_mutex_unlock(&mutex);
+	pthread_mutex_destroy(page_table_list->lock);
+	free(page_table_list->lock);
+	page_table_list->pid = REMOVED_PID;
+	page_tables_count--;
+	pthread_rwlock_unlock(&page_list_lock);
+}
+
+/* `pager_cleaner_start` starts a thread that writes dirty pages back
+ * to disk ahead of time, trying to keep at least `percent` percent
+ * of the frames free or clean so that evicting them needs no disk
+ * write in the fault path. */
+void pager_cleaner_start(int percent)
+{
+	pthread_t thread;
+
+	cleaner_target = percent;
+	pthread_create(&thread, NULL, cleaner_thread, NULL);
+	pthread_detach(thread);
+}
+
+/* `pager_readahead` turns on sequential-fault detection: when the
+ * last faults of a process keep the same stride, a fault also brings
+ * in up to `maxpages` of the following pages, in one message to the
+ * process.  The window starts at one page, grows by one page for
+ * each page brought in ahead of time that the process uses (it
+ * faults on it, or the stream's next fault comes at or past the end
+ * of the window) and halves when one is evicted unused. */
+void pager_readahead(int maxpages)
+{
+	readahead_max = maxpages;
+}
+
+/* `pager_policy` selects the page replacement policy by name (see
+ * policy.h) and returns 0, or returns -1 if there is no such policy.
+ * It must be called before `pager_init`; the default is
+ * "second-chance". */
+int pager_policy(const char *name)
+{
+	return policy_select(name);
 }
\ No newline at end of file
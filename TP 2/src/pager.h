@@ -55,4 +55,25 @@ int pager_syslog(pid_t pid, void *addr, size_t len);
  * functions. */
 void pager_destroy(pid_t pid);
 
+/* `pager_cleaner_start` starts a thread that writes dirty pages back
+ * to disk ahead of time, trying to keep at least `percent` percent
+ * of the frames free or clean so that evicting them needs no disk
+ * write in the fault path.  It is optional; the infrastructure calls
+ * it after `pager_init` when asked to. */
+void pager_cleaner_start(int percent);
+
+/* `pager_readahead` turns on sequential-fault detection.  When the
+ * last faults of a process keep the same stride, `pager_fault` also
+ * brings in up to `maxpages` of the following pages and maps them in
+ * the same message to the process.  It is optional; the
+ * infrastructure calls it after `pager_init` when asked to. */
+void pager_readahead(int maxpages);
+
+/* `pager_policy` selects the page replacement policy used when no
+ * frame is free, by name: "second-chance" (the default), "nru",
+ * "aging", "clock-pro", "arc" or "wsclock".  It returns -1 if there
+ * is no policy with that name, and 0 otherwise.  It is optional; the
+ * infrastructure calls it before `pager_init` when asked to. */
+int pager_policy(const char *name);
+
 #endif
@@ -0,0 +1,652 @@
+/* UNIVERSIDADE FEDERAL DE MINAS GERAIS     *
+ * DEPARTAMENTO DE CIENCIA DA COMPUTACAO    *
+ * Copyright (c) Italo Fernando Scota Cunha */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "policy.h"
+
+#define NO_FRAME -1
+// peso do bit de referência na idade do algoritmo aging
+#define AGING_TOP 0x80
+
+// estado comum a todas as políticas
+static int nframes;
+static int (*frame_state)(int frame_no);
+static int picks; // vítimas escolhidas desde a última varredura
+
+// estado das políticas; cada init aloca só o que usa
+static int *ref;             // bit de referência
+static int hand;             // ponteiro do relógio
+static unsigned char *age;   // aging: contador de idade
+static unsigned long now;    // wsclock e arc: tempo virtual, contado em faltas
+static unsigned long *stamp; // wsclock: último uso; arc: posição na lista LRU
+static unsigned long tau;    // wsclock: tamanho da janela do conjunto de trabalho
+static uint64_t *keys;       // clock-pro e arc: página em cada quadro
+
+// Função auxiliar para saber se o quadro pode ser despejado agora
+static int usable(int frame_no)
+{
+	return !(frame_state(frame_no) & POLICY_BUSY);
+}
+
+// Função auxiliar para saber se despejar o quadro exige escrita no disco
+static int dirty(int frame_no)
+{
+	return frame_state(frame_no) & POLICY_DIRTY;
+}
+
+// Função auxiliar para as políticas que não dependem do quadro 0: pede uma varredura
+// das permissões a cada nframes vítimas, ou seja, mais ou menos uma vez por volta
+static int sweep_due()
+{
+	if (++picks < nframes)
+		return 0;
+	picks = 0;
+	return 1;
+}
+
+static int clock_hand()
+{
+	return hand;
+}
+
+static void clock_access(int frame_no)
+{
+	ref[frame_no] = 1;
+}
+
+static void clock_free(int frame_no, int evicted)
+{
+}
+
+/**** second-chance ****/
+
+static void sc_init()
+{
+	ref = calloc(nframes, sizeof(int));
+	hand = 0;
+}
+
+// páginas trazidas antes da hora não contam como usadas
+static void sc_fault(int frame_no, uint64_t key, int prefetch)
+{
+	ref[frame_no] = !prefetch;
+}
+
+// Algoritmo da segunda chance; quadros em trânsito são pulados, e se depois de duas
+// voltas só sobrarem esses, retorna NO_FRAME.  A varredura acontece quando o ponteiro
+// volta ao quadro 0.
+static int sc_pick(int *sweep)
+{
+	for (int step = 0; step < 2 * nframes; step++)
+	{
+		int index = hand;
+		hand = (index + 1) % nframes;
+
+		if (!usable(index))
+			continue;
+		if (ref[index] == 0)
+		{
+			*sweep = index == 0;
+			return index;
+		}
+		ref[index] = 0;
+	}
+
+	return NO_FRAME;
+}
+
+/**** nru ****/
+
+// Segunda chance melhorada (NRU): a primeira volta procura uma página não referenciada
+// e limpa sem mexer nos bits; a segunda aceita uma suja e zera os bits por onde passa;
+// a terceira e a quarta repetem as duas primeiras com os bits já zerados
+static int nru_pick(int *sweep)
+{
+	for (int round = 0; round < 4; round++)
+	{
+		for (int step = 0; step < nframes; step++)
+		{
+			int index = hand;
+			hand = (index + 1) % nframes;
+
+			if (!usable(index))
+				continue;
+			if (ref[index] == 0 && (round % 2 == 1 || !dirty(index)))
+			{
+				*sweep = sweep_due();
+				return index;
+			}
+			if (round % 2 == 1)
+				ref[index] = 0;
+		}
+	}
+
+	return NO_FRAME;
+}
+
+/**** aging ****/
+
+static void aging_init()
+{
+	sc_init();
+	age = calloc(nframes, sizeof(unsigned char));
+}
+
+static void aging_fault(int frame_no, uint64_t key, int prefetch)
+{
+	ref[frame_no] = !prefetch;
+	age[frame_no] = 0;
+}
+
+// Cada escolha de vítima é um tique: a idade de todos os quadros anda um bit para a
+// direita e recebe o bit de referência no topo.  A vítima é a de menor idade, e o
+// empate fica com a primeira a partir do ponteiro.
+static int aging_pick(int *sweep)
+{
+	int victim = NO_FRAME;
+
+	for (int step = 0; step < nframes; step++)
+	{
+		int index = (hand + step) % nframes;
+		age[index] = (age[index] >> 1) | (ref[index] ? AGING_TOP : 0);
+		ref[index] = 0;
+
+		if (usable(index) && (victim == NO_FRAME || age[index] < age[victim]))
+			victim = index;
+	}
+
+	if (victim == NO_FRAME)
+		return NO_FRAME;
+
+	hand = (victim + 1) % nframes;
+	*sweep = sweep_due();
+	return victim;
+}
+
+/**** wsclock ****/
+
+static void ws_init()
+{
+	sc_init();
+	stamp = calloc(nframes, sizeof(unsigned long));
+	now = 0;
+	tau = nframes;
+}
+
+// páginas trazidas antes da hora ficam fora do conjunto de trabalho desde o início
+static void ws_fault(int frame_no, uint64_t key, int prefetch)
+{
+	now++;
+	ref[frame_no] = !prefetch;
+	stamp[frame_no] = prefetch ? 0 : now;
+}
+
+static void ws_access(int frame_no)
+{
+	now++;
+	ref[frame_no] = 1;
+	stamp[frame_no] = now;
+}
+
+// WSClock: uma página referenciada volta para o conjunto de trabalho; a primeira
+// limpa fora dele (sem uso há mais de tau faltas) é a vítima.  Sem nenhuma, fica com a
+// primeira suja fora do conjunto, ou então com a de uso mais antigo.  A escrita das
+// sujas fica com o despejo ou com o limpador.
+static int ws_pick(int *sweep)
+{
+	int dirty_old = NO_FRAME;
+	int oldest = NO_FRAME;
+
+	for (int lap = 0; lap < 2 && dirty_old == NO_FRAME && oldest == NO_FRAME; lap++)
+	{
+		for (int step = 0; step < nframes; step++)
+		{
+			int index = hand;
+			hand = (index + 1) % nframes;
+
+			if (!usable(index))
+				continue;
+			if (ref[index])
+			{
+				ref[index] = 0;
+				stamp[index] = now;
+				continue;
+			}
+			if (now - stamp[index] > tau)
+			{
+				if (!dirty(index))
+				{
+					*sweep = sweep_due();
+					return index;
+				}
+				if (dirty_old == NO_FRAME)
+					dirty_old = index;
+			}
+			if (oldest == NO_FRAME || stamp[index] < stamp[oldest])
+				oldest = index;
+		}
+	}
+
+	int victim = dirty_old != NO_FRAME ? dirty_old : oldest;
+	if (victim != NO_FRAME)
+		*sweep = sweep_due();
+	return victim;
+}
+
+/**** clock-pro ****/
+
+// CLOCK-Pro simplificado: páginas quentes e frias no mesmo relógio.  Uma página fria
+// nova entra em período de teste; se for referenciada nele, vira quente, e se for
+// despejada nele, a sua chave fica no histórico de não residentes.  Uma falta numa
+// chave do histórico traz a página já quente e aumenta a meta de quadros frios; uma
+// chave que sai do histórico sem ser usada a diminui.  O ponteiro das quentes esfria
+// a primeira quente não referenciada sempre que elas passam da sua parte.
+static int *hot;
+static int *test;
+static int nhot;
+static int hot_hand;
+static int cold_target;
+static uint64_t *ghost; // fila circular de chaves de páginas frias despejadas em teste
+static int ghost_head;
+static int ghost_count;
+
+static void cp_init()
+{
+	sc_init();
+	hot = calloc(nframes, sizeof(int));
+	test = calloc(nframes, sizeof(int));
+	keys = calloc(nframes, sizeof(uint64_t));
+	ghost = calloc(nframes, sizeof(uint64_t));
+	nhot = 0;
+	hot_hand = 0;
+	cold_target = nframes / 2 > 1 ? nframes / 2 : 1;
+	ghost_head = 0;
+	ghost_count = 0;
+}
+
+static int cp_ghost_find(uint64_t key)
+{
+	for (int i = 0; i < ghost_count; i++)
+		if (ghost[(ghost_head + i) % nframes] == key)
+			return i;
+	return NO_FRAME;
+}
+
+static void cp_ghost_remove(int pos)
+{
+	for (int i = pos; i > 0; i--)
+		ghost[(ghost_head + i) % nframes] = ghost[(ghost_head + i - 1) % nframes];
+	ghost_head = (ghost_head + 1) % nframes;
+	ghost_count--;
+}
+
+static void cp_ghost_push(uint64_t key)
+{
+	if (ghost_count == nframes)
+	{
+		// o período de teste da chave mais antiga acabou sem uso
+		cp_ghost_remove(0);
+		if (cold_target > 1)
+			cold_target--;
+	}
+	ghost[(ghost_head + ghost_count) % nframes] = key;
+	ghost_count++;
+}
+
+// Função auxiliar para esfriar páginas quentes até elas caberem na sua parte
+static void cp_balance()
+{
+	for (int step = 0; step < 2 * nframes && nhot > nframes - cold_target; step++)
+	{
+		int index = hot_hand;
+		hot_hand = (index + 1) % nframes;
+
+		if (!hot[index] || !usable(index))
+			continue;
+		if (ref[index])
+		{
+			ref[index] = 0;
+			continue;
+		}
+		hot[index] = 0;
+		test[index] = 0;
+		nhot--;
+	}
+}
+
+static void cp_promote(int frame_no)
+{
+	hot[frame_no] = 1;
+	test[frame_no] = 0;
+	nhot++;
+	cp_balance();
+}
+
+static void cp_fault(int frame_no, uint64_t key, int prefetch)
+{
+	keys[frame_no] = key;
+	ref[frame_no] = 0;
+	hot[frame_no] = 0;
+	test[frame_no] = !prefetch;
+
+	int pos = cp_ghost_find(key);
+	if (pos != NO_FRAME)
+	{
+		cp_ghost_remove(pos);
+		if (cold_target < nframes - 1)
+			cold_target++;
+		cp_promote(frame_no);
+	}
+}
+
+static int cp_pick(int *sweep)
+{
+	for (int step = 0; step < 2 * nframes; step++)
+	{
+		int index = hand;
+		hand = (index + 1) % nframes;
+
+		if (hot[index] || !usable(index))
+			continue;
+		if (ref[index])
+		{
+			ref[index] = 0;
+			if (test[index])
+				cp_promote(index);
+			else
+				test[index] = 1;
+			continue;
+		}
+		*sweep = sweep_due();
+		return index;
+	}
+
+	// só sobraram quentes: despeja a primeira que não estiver em trânsito
+	for (int step = 0; step < nframes; step++)
+	{
+		int index = hand;
+		hand = (index + 1) % nframes;
+		if (usable(index))
+		{
+			*sweep = sweep_due();
+			return index;
+		}
+	}
+
+	return NO_FRAME;
+}
+
+static void cp_free(int frame_no, int evicted)
+{
+	if (hot[frame_no])
+		nhot--;
+	else if (evicted && test[frame_no])
+		cp_ghost_push(keys[frame_no]);
+	hot[frame_no] = 0;
+	test[frame_no] = 0;
+}
+
+/**** arc ****/
+
+// ARC: T1 guarda as páginas vistas uma vez e T2 as vistas mais de uma vez; B1 e B2
+// guardam as chaves das que saíram de cada uma.  Uma falta numa chave de B1 aumenta p,
+// a meta de tamanho de T1, e uma em B2 a diminui.  T1 e T2 têm no máximo nframes
+// itens, então a ordem LRU delas vem de um carimbo de tempo e as buscas são lineares.
+// Uma chave do histórico não é usada de novo sem sair dele, então B1 e B2 são filas na
+// ordem de entrada, e a busca por chave passa por uma tabela de espalhamento.
+enum { ARC_NONE, ARC_T1, ARC_T2, ARC_B1, ARC_B2 };
+
+static int *arc_list;            // lista de cada quadro residente (T1 ou T2)
+static int arc_size[ARC_B2 + 1]; // itens em cada lista
+static int arc_p;
+
+// histórico: 2 * nframes posições, cada uma livre ou numa fila e numa cadeia da tabela
+static int *ghost_list;          // lista de cada posição (B1 ou B2)
+static uint64_t *ghost_keys;
+static int *ghost_prev;          // vizinhos na fila; as livres se ligam por ghost_next
+static int *ghost_next;
+static int *ghost_chain;         // próxima posição na mesma cadeia da tabela
+static int *ghost_bucket;        // primeira posição de cada cadeia
+static int ghost_mask;
+static int ghost_oldest[ARC_B2 + 1];
+static int ghost_newest[ARC_B2 + 1];
+static int ghost_free;
+
+static void arc_init()
+{
+	int size = 2 * nframes;
+	int buckets = 1;
+	while (buckets < size)
+		buckets *= 2;
+
+	arc_list = calloc(nframes, sizeof(int));
+	stamp = calloc(nframes, sizeof(unsigned long));
+	keys = calloc(nframes, sizeof(uint64_t));
+	ghost_list = calloc(size, sizeof(int));
+	ghost_keys = calloc(size, sizeof(uint64_t));
+	ghost_prev = calloc(size, sizeof(int));
+	ghost_next = calloc(size, sizeof(int));
+	ghost_chain = calloc(size, sizeof(int));
+	ghost_bucket = calloc(buckets, sizeof(int));
+	ghost_mask = buckets - 1;
+	for (int i = 0; i < buckets; i++)
+		ghost_bucket[i] = NO_FRAME;
+	for (int i = 0; i < size; i++)
+		ghost_next[i] = i + 1 < size ? i + 1 : NO_FRAME;
+	ghost_free = 0;
+	for (int list = ARC_NONE; list <= ARC_B2; list++)
+	{
+		arc_size[list] = 0;
+		ghost_oldest[list] = NO_FRAME;
+		ghost_newest[list] = NO_FRAME;
+	}
+	now = 0;
+	arc_p = 0;
+}
+
+static int arc_hash(uint64_t key)
+{
+	return (int)((key * 0x9e3779b97f4a7c15ull) >> 32) & ghost_mask;
+}
+
+static int arc_ghost_find(uint64_t key)
+{
+	for (int pos = ghost_bucket[arc_hash(key)]; pos != NO_FRAME; pos = ghost_chain[pos])
+		if (ghost_keys[pos] == key)
+			return pos;
+	return NO_FRAME;
+}
+
+// Função auxiliar para tirar uma chave do histórico: sai da sua fila e da tabela, e a
+// posição volta para as livres
+static void arc_ghost_remove(int pos)
+{
+	int list = ghost_list[pos];
+
+	if (ghost_prev[pos] != NO_FRAME)
+		ghost_next[ghost_prev[pos]] = ghost_next[pos];
+	else
+		ghost_oldest[list] = ghost_next[pos];
+	if (ghost_next[pos] != NO_FRAME)
+		ghost_prev[ghost_next[pos]] = ghost_prev[pos];
+	else
+		ghost_newest[list] = ghost_prev[pos];
+
+	int *link = &ghost_bucket[arc_hash(ghost_keys[pos])];
+	while (*link != pos)
+		link = &ghost_chain[*link];
+	*link = ghost_chain[pos];
+
+	arc_size[list]--;
+	ghost_list[pos] = ARC_NONE;
+	ghost_next[pos] = ghost_free;
+	ghost_free = pos;
+}
+
+// Função auxiliar para achar o quadro menos recente de uma lista; com `busy_ok` zerado
+// os quadros em trânsito são pulados
+static int arc_lru(int list, int busy_ok)
+{
+	int lru = NO_FRAME;
+	for (int i = 0; i < nframes; i++)
+	{
+		if (arc_list[i] != list || (!busy_ok && !usable(i)))
+			continue;
+		if (lru == NO_FRAME || stamp[i] < stamp[lru])
+			lru = i;
+	}
+	return lru;
+}
+
+static void arc_fault(int frame_no, uint64_t key, int prefetch)
+{
+	int b1 = arc_size[ARC_B1];
+	int b2 = arc_size[ARC_B2];
+	int pos = arc_ghost_find(key);
+
+	now++;
+	keys[frame_no] = key;
+	arc_list[frame_no] = ARC_T2;
+	if (pos != NO_FRAME && ghost_list[pos] == ARC_B1)
+	{
+		int delta = b2 > b1 ? b2 / b1 : 1;
+		arc_p = arc_p + delta < nframes ? arc_p + delta : nframes;
+	}
+	else if (pos != NO_FRAME)
+	{
+		int delta = b1 > b2 ? b1 / b2 : 1;
+		arc_p = arc_p > delta ? arc_p - delta : 0;
+	}
+	else
+		arc_list[frame_no] = ARC_T1;
+
+	if (pos != NO_FRAME)
+		arc_ghost_remove(pos);
+	arc_size[arc_list[frame_no]]++;
+
+	// páginas trazidas antes da hora entram no fim de T1
+	stamp[frame_no] = prefetch && arc_list[frame_no] == ARC_T1 ? 0 : now;
+}
+
+static void arc_access(int frame_no)
+{
+	now++;
+	arc_size[arc_list[frame_no]]--;
+	arc_list[frame_no] = ARC_T2;
+	arc_size[ARC_T2]++;
+	stamp[frame_no] = now;
+}
+
+// Função auxiliar para escolher a lista de onde sai a vítima: T1 se passou da meta p
+static int arc_victim_list()
+{
+	int t1 = arc_size[ARC_T1];
+	return t1 > 0 && t1 > arc_p ? ARC_T1 : ARC_T2;
+}
+
+static int arc_pick(int *sweep)
+{
+	int list = arc_victim_list();
+	int victim = arc_lru(list, 0);
+	if (victim == NO_FRAME)
+		victim = arc_lru(list == ARC_T1 ? ARC_T2 : ARC_T1, 0);
+
+	if (victim != NO_FRAME)
+		*sweep = sweep_due();
+	return victim;
+}
+
+// Função auxiliar para guardar no histórico a chave de uma página despejada; os
+// limites do ARC são |T1| + |B1| <= nframes e o total de itens <= 2 * nframes, e quem
+// sai para abrir espaço é a chave mais antiga da fila
+static void arc_ghost_push(uint64_t key, int list)
+{
+	int t1 = arc_size[ARC_T1];
+	int t2 = arc_size[ARC_T2];
+	int b1 = arc_size[ARC_B1];
+	int b2 = arc_size[ARC_B2];
+
+	if (list == ARC_B1 && t1 + b1 >= nframes && b1 > 0)
+		arc_ghost_remove(ghost_oldest[ARC_B1]);
+	else if (t1 + t2 + b1 + b2 >= 2 * nframes)
+		arc_ghost_remove(ghost_oldest[b2 > 0 ? ARC_B2 : ARC_B1]);
+
+	int pos = ghost_free;
+	if (pos == NO_FRAME)
+		return;
+	ghost_free = ghost_next[pos];
+	ghost_list[pos] = list;
+	ghost_keys[pos] = key;
+
+	ghost_prev[pos] = ghost_newest[list];
+	ghost_next[pos] = NO_FRAME;
+	if (ghost_newest[list] != NO_FRAME)
+		ghost_next[ghost_newest[list]] = pos;
+	else
+		ghost_oldest[list] = pos;
+	ghost_newest[list] = pos;
+
+	int bucket = arc_hash(key);
+	ghost_chain[pos] = ghost_bucket[bucket];
+	ghost_bucket[bucket] = pos;
+	arc_size[list]++;
+}
+
+static void arc_free(int frame_no, int evicted)
+{
+	int list = arc_list[frame_no];
+
+	arc_list[frame_no] = ARC_NONE;
+	if (list == ARC_NONE)
+		return;
+	arc_size[list]--;
+	if (evicted)
+		arc_ghost_push(keys[frame_no], list == ARC_T1 ? ARC_B1 : ARC_B2);
+}
+
+static int arc_hand()
+{
+	int lru = arc_lru(arc_victim_list(), 1);
+	return lru == NO_FRAME ? 0 : lru;
+}
+
+/**** registro ****/
+
+static const policy_t policies[] = {
+	{ "second-chance", sc_init, sc_fault, clock_access, sc_pick, clock_free, clock_hand },
+	{ "nru", sc_init, sc_fault, clock_access, nru_pick, clock_free, clock_hand },
+	{ "aging", aging_init, aging_fault, clock_access, aging_pick, clock_free, clock_hand },
+	{ "clock-pro", cp_init, cp_fault, clock_access, cp_pick, cp_free, clock_hand },
+	{ "arc", arc_init, arc_fault, arc_access, arc_pick, arc_free, arc_hand },
+	{ "wsclock", ws_init, ws_fault, ws_access, ws_pick, clock_free, clock_hand },
+};
+
+#define NPOLICIES (int)(sizeof(policies) / sizeof(policies[0]))
+
+const policy_t *policy = &policies[0];
+
+int policy_select(const char *name)
+{
+	for (int i = 0; i < NPOLICIES; i++)
+	{
+		if (strcmp(policies[i].name, name) == 0)
+		{
+			policy = &policies[i];
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+void policy_init(int count, int (*state)(int frame_no))
+{
+	nframes = count;
+	frame_state = state;
+	picks = 0;
+	policy->init();
+}
@@ -0,0 +1,58 @@
+/* Page replacement policies for the pager.  The pager only learns about
+ * accesses through faults: a page is brought in (`on_fault`), or a resident
+ * page faults because it was mapped read-only or lost its permissions in a
+ * sweep (`on_access`).  When it needs a frame and none is free, it asks the
+ * policy for a victim (`pick_victim`), and it reports every frame that stops
+ * holding a page (`on_free`).
+ *
+ * The pager calls every operation with its frame lock held, so policies need
+ * no locking of their own.  Frames in transit must never be picked, and some
+ * policies prefer clean victims; both are read through the callback given to
+ * `policy_init`.  `pick_victim` returns -1 if every frame is in transit.  It
+ * sets `*sweep` when the pager should revoke the permissions of every
+ * resident page, so that the next access to each page faults and reaches
+ * `on_access`. */
+
+#ifndef __POLICY_HEADER__
+#define __POLICY_HEADER__
+
+#include <stdint.h>
+
+/* bits returned by the frame state callback */
+#define POLICY_BUSY 1  /* page in transit; cannot be evicted now */
+#define POLICY_DIRTY 2 /* page may differ from its copy on disk */
+
+/* key of page number `index` of process `pid`.  Policies that remember
+ * evicted pages compare keys, so keys must outlive the pages: page_t
+ * addresses are reused as soon as an exited process's table is freed,
+ * while (pid, index) only repeats if the system reuses the pid. */
+#define POLICY_KEY(pid, index) (((uint64_t)(uint32_t)(pid) << 32) | (uint32_t)(index))
+
+typedef struct policy_t
+{
+	const char *name;
+	void (*init)(void);
+	/* a page identified by `key` (see POLICY_KEY) now occupies `frame_no`;
+	 * `prefetch` is set for pages brought in by readahead, which were not
+	 * accessed yet */
+	void (*on_fault)(int frame_no, uint64_t key, int prefetch);
+	void (*on_access)(int frame_no);
+	int (*pick_victim)(int *sweep);
+	/* `evicted` is 0 when the frame is freed because its process died */
+	void (*on_free)(int frame_no, int evicted);
+	/* frame the victim search will look at next; the cleaner scans from it */
+	int (*hand)(void);
+} policy_t;
+
+extern const policy_t *policy;
+
+/* `policy_select` makes `name` the current policy and returns 0, or
+ * returns -1 if there is no policy with that name.  It must be called
+ * before `policy_init`.  The default policy is "second-chance". */
+int policy_select(const char *name);
+
+/* `policy_init` prepares the current policy for `nframes` frames.
+ * `state` returns the POLICY_* bits of a frame holding a page. */
+void policy_init(int nframes, int (*state)(int frame_no));
+
+#endif
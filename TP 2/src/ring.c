@@ -0,0 +1,193 @@
+#define _GNU_SOURCE
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ring.h"
+
+/* sleepers wake up this often to notice a peer that died without closing */
+#define RING_WAIT_NS 50000000L
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ring_relax() __builtin_ia32_pause()
+#else
+#define ring_relax() do { } while(0)
+#endif
+
+struct ring_shm * ring_shm_create(int *fd, uint32_t spins)/*{{{*/
+{
+	*fd = memfd_create("mmu.ring", MFD_CLOEXEC);
+	if(*fd == -1) return NULL;
+	if(ftruncate(*fd, sizeof(struct ring_shm)) == -1) goto out_fd;
+	struct ring_shm *shm = ring_shm_map(*fd);
+	if(!shm) goto out_fd;
+	shm->spins = spins;
+	return shm;
+
+	out_fd:
+	close(*fd);
+	*fd = -1;
+	return NULL;
+}/*}}}*/
+
+struct ring_shm * ring_shm_map(int fd)/*{{{*/
+{
+	void *p = mmap(NULL, sizeof(struct ring_shm), PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0);
+	if(p == MAP_FAILED) return NULL;
+	return p;
+}/*}}}*/
+
+void ring_shm_unmap(struct ring_shm *shm)/*{{{*/
+{
+	munmap(shm, sizeof(*shm));
+}/*}}}*/
+
+static void ring_wake(struct ring *r, _Atomic uint32_t *word)/*{{{*/
+{
+	if(atomic_load(&r->sleepers) == 0) return;
+	syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}/*}}}*/
+
+static int ring_hungup(int sock)/*{{{*/
+{
+	struct pollfd pfd = { .fd = sock, .events = POLLRDHUP };
+	if(poll(&pfd, 1, 0) <= 0) return 0;
+	return (pfd.revents & (POLLRDHUP | POLLHUP | POLLERR)) != 0;
+}/*}}}*/
+
+/* waits until `word` no longer holds `seen`: busy-polls, then sleeps on
+ * the futex.  returns -1 if the ring was closed or the peer hung up. */
+static int ring_wait(struct ring_shm *shm, struct ring *r,/*{{{*/
+		_Atomic uint32_t *word, uint32_t seen, int sock)
+{
+	for(uint32_t i = 0; i < shm->spins; ++i) {
+		if(atomic_load_explicit(word, memory_order_acquire) != seen)
+			return 0;
+		ring_relax();
+	}
+
+	/* sleepers is raised before the last check, and producers read it
+	 * after publishing, so either we see the new value or they see us. */
+	atomic_fetch_add(&r->sleepers, 1);
+	if(atomic_load(word) == seen && !atomic_load(&r->closed)) {
+		struct timespec ts = { 0, RING_WAIT_NS };
+		syscall(SYS_futex, word, FUTEX_WAIT, seen, &ts, NULL, 0);
+	}
+	atomic_fetch_sub(&r->sleepers, 1);
+
+	if(atomic_load(&r->closed)) return -1;
+	if(atomic_load(word) == seen && ring_hungup(sock)) return -1;
+	return 0;
+}/*}}}*/
+
+ssize_t ring_send(struct ring_shm *shm, struct ring *r, pthread_mutex_t *lock,/*{{{*/
+		int sock, const void *buf, size_t len)
+{
+	if(len > RING_SIZE) {
+		errno = EMSGSIZE;
+		return -1;
+	}
+	for(;;) {
+		if(lock) pthread_mutex_lock(lock);
+		uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+		uint32_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+		if(RING_SIZE - (head - tail) >= len) {
+			uint32_t off = head % RING_SIZE;
+			size_t first = len < RING_SIZE - off ? len : RING_SIZE - off;
+			memcpy(r->data + off, buf, first);
+			memcpy(r->data, (const char *)buf + first, len - first);
+			atomic_store(&r->head, head + (uint32_t)len);
+			if(lock) pthread_mutex_unlock(lock);
+			ring_wake(r, &r->head);
+			return len;
+		}
+		if(lock) pthread_mutex_unlock(lock);
+		if(atomic_load(&r->closed)) return -1;
+		if(ring_wait(shm, r, &r->tail, tail, sock) == -1) return -1;
+	}
+}/*}}}*/
+
+ssize_t ring_recv(struct ring_shm *shm, struct ring *r, pthread_mutex_t *lock,/*{{{*/
+		int sock, void *buf, size_t len, int peek)
+{
+	if(len > RING_SIZE) {
+		errno = EMSGSIZE;
+		return -1;
+	}
+	for(;;) {
+		if(lock) pthread_mutex_lock(lock);
+		uint32_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+		uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+		if(head - tail >= len) {
+			uint32_t off = tail % RING_SIZE;
+			size_t first = len < RING_SIZE - off ? len : RING_SIZE - off;
+			memcpy(buf, r->data + off, first);
+			memcpy((char *)buf + first, r->data, len - first);
+			if(!peek) atomic_store(&r->tail, tail + (uint32_t)len);
+			if(lock) pthread_mutex_unlock(lock);
+			if(!peek) ring_wake(r, &r->tail);
+			return len;
+		}
+		if(lock) pthread_mutex_unlock(lock);
+		/* the peer may publish its last message and close right after
+		 * we looked, so only give up if nothing arrived meanwhile */
+		if(atomic_load(&r->closed)
+				|| ring_wait(shm, r, &r->head, head, sock) == -1) {
+			if(atomic_load(&r->head) == head) return 0;
+		}
+	}
+}/*}}}*/
+
+void ring_close(struct ring *r)/*{{{*/
+{
+	atomic_store(&r->closed, 1);
+	syscall(SYS_futex, &r->head, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+	syscall(SYS_futex, &r->tail, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}/*}}}*/
+
+ssize_t ring_sendfd(int sock, int fd, const void *buf, size_t len)/*{{{*/
+{
+	struct iovec iov = { .iov_base = (void *)buf, .iov_len = len };
+	char ctl[CMSG_SPACE(sizeof(int))];
+	memset(ctl, 0, sizeof(ctl));
+	struct msghdr msg = {
+		.msg_iov = &iov, .msg_iovlen = 1,
+		.msg_control = ctl, .msg_controllen = sizeof(ctl),
+	};
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+	return sendmsg(sock, &msg, 0);
+}/*}}}*/
+
+ssize_t ring_recvfd(int sock, int *fd, void *buf, size_t len)/*{{{*/
+{
+	struct iovec iov = { .iov_base = buf, .iov_len = len };
+	char ctl[CMSG_SPACE(sizeof(int))];
+	struct msghdr msg = {
+		.msg_iov = &iov, .msg_iovlen = 1,
+		.msg_control = ctl, .msg_controllen = sizeof(ctl),
+	};
+	*fd = -1;
+	ssize_t cnt = recvmsg(sock, &msg, MSG_WAITALL | MSG_CMSG_CLOEXEC);
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	if(cnt > 0 && cmsg && cmsg->cmsg_level == SOL_SOCKET &&
+			cmsg->cmsg_type == SCM_RIGHTS) {
+		memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+	}
+	return cnt;
+}/*}}}*/
@@ -0,0 +1,73 @@
+/* This module implements the shared-memory transport between uvm clients and
+ * the MMU.  A client creates a =memfd= holding two single-producer
+ * single-consumer byte rings (client to MMU and MMU to client), passes the
+ * descriptor to the MMU over the unix socket with SCM_RIGHTS, and from then on
+ * both sides exchange the same protocol messages through the rings instead of
+ * the socket.  Connection setup stays on the socket, which is also used to
+ * detect that the peer went away.
+ *
+ * The rings are lock-free between the two processes: the producer only
+ * writes =head= and the consumer only writes =tail=.  Messages are written
+ * and read whole.  A side waiting for data (or for room) busy-polls for
+ * =spins= iterations and then sleeps on a futex on the index the other side
+ * advances.  Threads of the same process that share a direction must pass a
+ * mutex; it is only held while copying, never while waiting. */
+
+#ifndef __RING_HEADER__
+#define __RING_HEADER__
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define RING_SIZE (1 << 16)
+#define RING_DEFAULT_SPINS 200
+
+struct ring {
+	_Atomic uint32_t head; /* bytes ever written, advanced by the producer */
+	char pad0[60];
+	_Atomic uint32_t tail; /* bytes ever read, advanced by the consumer */
+	char pad1[60];
+	_Atomic uint32_t closed;
+	_Atomic uint32_t sleepers;
+	char pad2[56];
+	char data[RING_SIZE];
+};
+
+struct ring_shm {
+	uint32_t spins;
+	char pad[60];
+	struct ring c2s; /* uvm to MMU */
+	struct ring s2c; /* MMU to uvm */
+};
+
+/* This function creates and maps a new shared transport, storing the
+ * =memfd= descriptor in =fd=.  Returns NULL on failure. */
+struct ring_shm * ring_shm_create(int *fd, uint32_t spins);
+
+/* This function maps a transport received from a peer.  Returns NULL on
+ * failure. */
+struct ring_shm * ring_shm_map(int fd);
+
+void ring_shm_unmap(struct ring_shm *shm);
+
+/* These functions behave like =send= and =recv= with MSG_WAITALL on the
+ * socket =sock=: =ring_send= returns =len= or -1 if the ring was closed or
+ * the peer hung up; =ring_recv= returns =len= or 0 in the same cases.
+ * =ring_recv= with =peek= set does not consume the bytes.  =lock= may be
+ * NULL when only one thread uses that direction. */
+ssize_t ring_send(struct ring_shm *shm, struct ring *r, pthread_mutex_t *lock,
+		int sock, const void *buf, size_t len);
+ssize_t ring_recv(struct ring_shm *shm, struct ring *r, pthread_mutex_t *lock,
+		int sock, void *buf, size_t len, int peek);
+
+/* This function marks =r= as closed and wakes any side waiting on it. */
+void ring_close(struct ring *r);
+
+/* These functions pass a descriptor over a unix socket along with a
+ * message of =len= bytes.  They return =len= on success. */
+ssize_t ring_sendfd(int sock, int fd, const void *buf, size_t len);
+ssize_t ring_recvfd(int sock, int *fd, void *buf, size_t len);
+
+#endif
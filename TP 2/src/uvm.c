@@ -25,6 +25,7 @@
 
 #include "mmu.h"
 #include "mmuproto.h"
+#include "ring.h"
 
 /****************************************************************************
  * structure definitions and static variables
@@ -39,6 +40,9 @@ struct uvm_data {/*{{{*/
 	char *pmem_fn;
 	int pmem_fd;
 	intptr_t result;
+	struct ring_shm *ring; /* NULL while talking over the socket */
+	int ring_fd;
+	pthread_mutex_t ring_tx;
 };/*}}}*/
 
 static struct uvm_data *uvm = NULL;
@@ -56,9 +60,13 @@ static void uvm_proto_syslog_rep(void);
 static void uvm_proto_segv_rep(void);
 static void uvm_proto_remap_rep(void);
 static void uvm_proto_chprot_rep(void);
+static void uvm_proto_batch_rep(void);
 
 /* Helper functions */
 static void uvm_connect_socket(int sock, const struct sockaddr_un * addr);
+static void uvm_ring_setup(void);
+static ssize_t uvm_send(const void *buf, size_t len);
+static ssize_t uvm_recv(void *buf, size_t len, int flags);
 
 #define NUM_CONNECTION_TRIES 3
 
@@ -110,6 +118,13 @@ void uvm_create(void)/*{{{*/
 	if(uvm->pmem_fd == -1)
 		prexit();
 
+	uvm->ring = NULL;
+	uvm->ring_fd = -1;
+	pthread_mutex_init(&uvm->ring_tx, NULL);
+	char *transport = getenv("UVM_TRANSPORT");
+	if(transport && !strcmp(transport, "ring"))
+		uvm_ring_setup();
+
 	logd(LOG_DEBUG, "  setting up SEGV handler\n");
 	struct sigaction new;
 	new.sa_sigaction = uvm_segv_action;
@@ -133,7 +148,7 @@ void * uvm_extend(void) {/*{{{*/
 	pthread_mutex_lock(&uvm->mutex);
 	struct mmu_proto_extend_req req;
 	req.type = MMU_PROTO_EXTEND_REQ;
-	if(send(uvm->sock, &req, sizeof(req), 0) != sizeof(req))
+	if(uvm_send(&req, sizeof(req)) != sizeof(req))
 		prexit();
 	pthread_cond_wait(&uvm->cond, &uvm->mutex);
 	if(uvm->result) uvm->npages++;
@@ -148,7 +163,7 @@ int uvm_syslog(void *addr, size_t len)/*{{{*/
 	req.type = MMU_PROTO_SYSLOG_REQ;
 	req.addr = (intptr_t)addr;
 	req.len = len;
-	if(send(uvm->sock, &req, sizeof(req), 0) != sizeof(req))
+	if(uvm_send(&req, sizeof(req)) != sizeof(req))
 		prexit();
 	pthread_cond_wait(&uvm->cond, &uvm->mutex);
 	if(uvm->result != 0) errno = EINVAL;
@@ -169,7 +184,7 @@ void * uvm_thread(void *data) {/*{{{*/
 	while(uvm->running) {
 		logd(LOG_DEBUG, "uvm_thread waiting message\n");
 		uint32_t type;
-		ssize_t c = recv(uvm->sock, &type, sizeof(type), MSG_PEEK);
+		ssize_t c = uvm_recv(&type, sizeof(type), MSG_PEEK);
 		if(!uvm->running) break;
 		if(c != sizeof(type)) prexit();
 		pthread_mutex_lock(&uvm->mutex);
@@ -189,6 +204,10 @@ void * uvm_thread(void *data) {/*{{{*/
 			case MMU_PROTO_CHPROT_REP:
 				uvm_proto_chprot_rep();
 				break;
+			case MMU_PROTO_REMAP_BATCH_REP:
+			case MMU_PROTO_CHPROT_BATCH_REP:
+				uvm_proto_batch_rep();
+				break;
 			case MMU_PROTO_EXIT_REP:
 				uvm->running = 0;
 				break;
@@ -208,10 +227,15 @@ void uvm_exit(int status, void *arg)/*{{{*/
 	struct mmu_proto_exit_req req;
 	req.type = MMU_PROTO_EXIT_REQ;
 	/* socket may have been closed by the MMU, ignore return value: */
-	send(uvm->sock, &req, sizeof(req), 0);
+	uvm_send(&req, sizeof(req));
 	pthread_mutex_unlock(&(uvm->mutex));
 	pthread_join(uvm->thread, NULL);
 	close(uvm->sock);
+	if(uvm->ring) {
+		ring_shm_unmap(uvm->ring);
+		close(uvm->ring_fd);
+	}
+	pthread_mutex_destroy(&uvm->ring_tx);
 
 	pthread_mutex_destroy(&uvm->mutex);
 	pthread_cond_destroy(&uvm->cond);
@@ -247,7 +271,7 @@ void uvm_segv_action(int signum, siginfo_t *si, void *context)/*{{{*/
 	req.type = MMU_PROTO_SEGV_REQ;
 	req.addr = (intptr_t)si->si_addr;
 	req.code = si->si_code;
-	if(send(uvm->sock, &req, sizeof(req), 0) != sizeof(req)) prexit();
+	if(uvm_send(&req, sizeof(req)) != sizeof(req)) prexit();
 
 	logd(LOG_DEBUG, "%s waiting service at condition variable\n", __func__);
 	pthread_cond_wait(&uvm->cond, &uvm->mutex);
@@ -262,7 +286,7 @@ void uvm_proto_extend_rep(void)/*{{{*/
 {
 	logd(LOG_DEBUG, "processing EXTEND_REP\n");
 	struct mmu_proto_extend_rep rep;
-	if(recv(uvm->sock, &rep, sizeof(rep), 0) != sizeof(rep))
+	if(uvm_recv(&rep, sizeof(rep), 0) != sizeof(rep))
 		prexit();
 	assert(rep.type == MMU_PROTO_EXTEND_REP);
 	uvm->result = (intptr_t)rep.vaddr;
@@ -273,7 +297,7 @@ void uvm_proto_syslog_rep(void)/*{{{*/
 {
 	logd(LOG_DEBUG, "processing SYSLOG_REP\n");
 	struct mmu_proto_syslog_rep rep;
-	if(recv(uvm->sock, &rep, sizeof(rep), 0) != sizeof(rep))
+	if(uvm_recv(&rep, sizeof(rep), 0) != sizeof(rep))
 		prexit();
 	assert(rep.type == MMU_PROTO_SYSLOG_REP);
 	uvm->result = (intptr_t)rep.retcode;
@@ -284,7 +308,7 @@ void uvm_proto_segv_rep(void)/*{{{*/
 {
 	logd(LOG_DEBUG, "processing SEGV_REP\n");
 	struct mmu_proto_segv_rep rep;
-	if(recv(uvm->sock, &rep, sizeof(rep), 0) != sizeof(rep))
+	if(uvm_recv(&rep, sizeof(rep), 0) != sizeof(rep))
 		prexit();
 	assert(rep.type == MMU_PROTO_SEGV_REP);
 	pthread_cond_signal(&uvm->cond);
@@ -294,7 +318,7 @@ void uvm_proto_remap_rep(void)/*{{{*/
 {
 	logd(LOG_DEBUG, "processing REMAP_REP\n");
 	struct mmu_proto_remap_rep rep;
-	if(recv(uvm->sock, &rep, sizeof(rep), 0) != sizeof(rep))
+	if(uvm_recv(&rep, sizeof(rep), 0) != sizeof(rep))
 		prexit();
 	assert(rep.type == MMU_PROTO_REMAP_REP);
 	assert(rep.prot != PROT_NONE);
@@ -316,14 +340,14 @@ void uvm_proto_remap_rep(void)/*{{{*/
 
 	struct mmu_proto_remap_req req;
 	req.type = MMU_PROTO_REMAP_REQ;
-	if(send(uvm->sock, &req, sizeof(req), 0) != sizeof(req)) prexit();
+	if(uvm_send(&req, sizeof(req)) != sizeof(req)) prexit();
 }/*}}}*/
 
 void uvm_proto_chprot_rep(void)/*{{{*/
 {
 	logd(LOG_DEBUG, "processing CHPROT_REP\n");
 	struct mmu_proto_chprot_rep rep;
-	if(recv(uvm->sock, &rep, sizeof(rep), 0) != sizeof(rep))
+	if(uvm_recv(&rep, sizeof(rep), 0) != sizeof(rep))
 		prexit();
 	assert(rep.type == MMU_PROTO_CHPROT_REP);
 
@@ -342,7 +366,114 @@ void uvm_proto_chprot_rep(void)/*{{{*/
 
 	struct mmu_proto_chprot_req req;
 	req.type = MMU_PROTO_CHPROT_REQ;
-	if(send(uvm->sock, &req, sizeof(req), 0) != sizeof(req)) prexit();
+	if(uvm_send(&req, sizeof(req)) != sizeof(req)) prexit();
+}/*}}}*/
+
+static int uvm_batch_entry_cmp(const void *va, const void *vb)/*{{{*/
+{
+	const struct mmu_proto_batch_entry *a = va, *b = vb;
+	if(a->vaddr < b->vaddr) return -1;
+	return a->vaddr > b->vaddr;
+}/*}}}*/
+
+void uvm_proto_batch_rep(void)/*{{{*/
+{
+	logd(LOG_DEBUG, "processing BATCH_REP\n");
+	struct mmu_proto_batch_rep rep;
+	if(uvm_recv(&rep, sizeof(rep), 0) != sizeof(rep))
+		prexit();
+	assert(rep.type == MMU_PROTO_REMAP_BATCH_REP ||
+			rep.type == MMU_PROTO_CHPROT_BATCH_REP);
+	assert(rep.count <= MMU_PROTO_BATCH_MAX);
+	int remap = rep.type == MMU_PROTO_REMAP_BATCH_REP;
+
+	struct mmu_proto_batch_entry e[MMU_PROTO_BATCH_MAX];
+	ssize_t esz = rep.count * sizeof(e[0]);
+	if(uvm_recv(e, esz, MSG_WAITALL) != esz)
+		prexit();
+
+	/* sort by address and apply each run of adjacent pages with
+	 * the same protection (and contiguous frames, when remapping)
+	 * as a single call. */
+	qsort(e, rep.count, sizeof(e[0]), uvm_batch_entry_cmp);
+	size_t pagesz = sysconf(_SC_PAGESIZE);
+	for(uint32_t i = 0, j; i < rep.count; i = j) {
+		for(j = i + 1; j < rep.count; ++j) {
+			if(e[j].prot != e[i].prot) break;
+			if(e[j].vaddr != e[i].vaddr + (j - i) * pagesz) break;
+			if(remap && e[j].offset != e[i].offset + (j - i) * pagesz)
+				break;
+		}
+		assert(e[i].vaddr < UINTPTR_MAX);
+		void *addr = (void *)(uintptr_t)e[i].vaddr;
+		int prot = (int)e[i].prot;
+		size_t len = (j - i) * pagesz;
+		if(remap) {
+			assert(prot != PROT_NONE);
+			off_t off = (off_t)e[i].offset;
+			logd(LOG_DEBUG, "remapping %p len %zu at offset %llu prot %d\n",
+					addr, len, (unsigned long long)off, prot);
+			munmap(addr, len);
+			void *r = mmap(addr, len, prot, MAP_SHARED, uvm->pmem_fd, off);
+			if(r != addr)
+				prexit();
+		}
+		logd(LOG_DEBUG, "mprotect %p len %zu prot %d\n", addr, len, prot);
+		if(mprotect(addr, len, prot) == -1)
+			prexit();
+	}
+
+	struct mmu_proto_batch_req req;
+	req.type = remap ? MMU_PROTO_REMAP_BATCH_REQ : MMU_PROTO_CHPROT_BATCH_REQ;
+	if(uvm_send(&req, sizeof(req)) != sizeof(req)) prexit();
+}/*}}}*/
+
+/****************************************************************************
+ * transport functions
+ ***************************************************************************/
+void uvm_ring_setup(void)/*{{{*/
+{
+	/* spinning only pays off if the MMU can run at the same time */
+	uint32_t spins = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? RING_DEFAULT_SPINS : 0;
+	char *env = getenv("UVM_RING_SPINS");
+	if(env) spins = (uint32_t)strtoul(env, NULL, 10);
+
+	logd(LOG_DEBUG, "  creating shared rings [%u spins]\n", spins);
+	struct ring_shm *ring = ring_shm_create(&uvm->ring_fd, spins);
+	if(!ring) prexit();
+
+	struct mmu_proto_ring_req req;
+	req.type = MMU_PROTO_RING_REQ;
+	if(ring_sendfd(uvm->sock, uvm->ring_fd, &req, sizeof(req)) != sizeof(req))
+		prexit();
+	struct mmu_proto_ring_rep rep;
+	if(recv(uvm->sock, &rep, sizeof(rep), 0) != sizeof(rep)) prexit();
+	assert(rep.type == MMU_PROTO_RING_REP);
+	if(rep.status != 0) {
+		logd(LOG_WARN, "  MMU refused shared rings, staying on socket\n");
+		ring_shm_unmap(ring);
+		close(uvm->ring_fd);
+		uvm->ring_fd = -1;
+		return;
+	}
+	uvm->ring = ring;
+}/*}}}*/
+
+ssize_t uvm_send(const void *buf, size_t len)/*{{{*/
+{
+	if(uvm->ring)
+		return ring_send(uvm->ring, &uvm->ring->c2s, &uvm->ring_tx,
+				uvm->sock, buf, len);
+	return send(uvm->sock, buf, len, 0);
+}/*}}}*/
+
+ssize_t uvm_recv(void *buf, size_t len, int flags)/*{{{*/
+{
+	/* only uvm_thread reads after setup, so no lock here */
+	if(uvm->ring)
+		return ring_recv(uvm->ring, &uvm->ring->s2c, NULL, uvm->sock,
+				buf, len, flags & MSG_PEEK);
+	return recv(uvm->sock, buf, len, flags);
 }/*}}}*/
 
 /****************************************************************************